@@ -10,8 +10,29 @@
  * GNU GPLv2 - see LICENSE file
  */
 
+#ifndef BINHEAPPQ_CPP
+#define BINHEAPPQ_CPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <new>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if !defined(BINHEAPPQ_NO_SIMD) && defined(__GNUC__) && (defined(__SSE4_1__) || defined(__AVX2__) || defined(__AVX512F__))
+#include <immintrin.h>
+#define BINHEAPPQ_SIMD
+#endif
+
 /**
- * Type of priorities used, you can change it if you want a different range of values.
+ * Default type of priorities, BinHeapPQ takes any other as its Key parameter.
  */
 typedef unsigned int		py_t;
 /**
@@ -25,69 +46,1029 @@ typedef unsigned short int	pos_t;
  *
  * You haven't to create or manipulate them. It associates the value/item
  * stored with its priority and its position.
- * A "reference" (aka a const pointer) to a priority item is returned
- * when you emplace an item/value in the queue; you can use this pointer
- * for monitoring or referring to the priority item.
+ * A "reference" (aka a checked const pointer, see ItemHandle) to a priority
+ * item is returned when you emplace an item/value in the queue; you can use
+ * this handle for monitoring or referring to the priority item.
  */
-template <class T>
+template <class T, class Pos = pos_t, class Key = py_t>
 struct PriorityItem {
-  py_t	priority; /**< Priority of this item.    */
+  Key	priority; /**< Priority of this item.    */
   T	item;     /**< The value of item stored. */
-  pos_t pos;      /**< Position in the queue.    */
+  Pos pos;      /**< Position in the queue (PointerLayout) or slot in the pool (InlineLayout). */
+  
+  /** Construct the value in place, forwarding the arguments to the constructor of T. */
+  template <class... Args>
+  PriorityItem(const Key& priority, Pos pos, Args&&... args)
+    : priority(priority), item(std::forward<Args>(args)...), pos(pos) {}
+};
+
+/**
+ * Pool of raw (unconstructed) slots for the items, addressed by slot index.
+ *
+ * The first chunk of slots is a power of two not lesser than the initial
+ * capacity, so a pool that never grows is a single contiguous slab; every
+ * chunk added is as big as all the previous ones (the capacity doubles),
+ * so a pool started small still allocates O(log(n)) chunks, and the chunk
+ * of a slot is found with a bit scan. Growing never moves the slots, so
+ * the pointers to the items stay valid.
+ * Every slot has a generation, incremented when its item is destroyed:
+ * it tells a handle to the item from a handle to an item deleted before.
+ */
+template <class Item, class Pos>
+class ItemPool {
+private:
+  struct Slot {
+    typename std::aligned_storage<sizeof(Item), alignof(Item)>::type storage; /**< The item (raw memory). */
+    unsigned generation; /**< Number of items destroyed in this slot. */
+  };
+  std::vector<Slot*> chunks;	/**< Chunks of slots.                         */
+  unsigned shift;		/**< Log2 of the number of slots of the first. */
+  static Slot* allocate(std::size_t);
+  static unsigned width(std::size_t x) { return std::numeric_limits<unsigned long long>::digits - __builtin_clzll((x << 1) | 1) - 1; }
+public:
+  ItemPool(Pos);
+  ~ItemPool();
+  ItemPool(const ItemPool&) = delete;
+  ItemPool& operator=(const ItemPool&) = delete;
+  Item* at(Pos slot) const {
+    unsigned c = width(std::size_t(slot) >> shift); // chunk c > 0 starts at 2^(shift+c-1)
+    std::size_t first = c ? std::size_t(1) << (shift + c - 1) : 0;
+    return reinterpret_cast<Item*>(&chunks[c][std::size_t(slot) - first].storage);
+  }
+  static unsigned generation(const Item* item) { return reinterpret_cast<const Slot*>(item)->generation; }
+  static void retire(Item* item) { reinterpret_cast<Slot*>(item)->generation++; }
+  std::size_t capacity() const { return (std::size_t(1) << shift) << (chunks.size() - 1); }
+  void grow(Pos);
+  bool adopt(ItemPool&);
+};
+
+/**
+ * Checked handle to an item: a pointer to its slot and the generation of the slot.
+ *
+ * It's returned when you emplace an item, and it works as a read-only
+ * pointer to the PriorityItem while the item is in the queue; after the
+ * item is deleted the handle is stale (the queue's contains() is false,
+ * and decrease, increase and erase ignore it). A default handle is null.
+ */
+template <class T, class Pos = pos_t, class Key = py_t>
+class ItemHandle {
+private:
+  const PriorityItem<T, Pos, Key>* pi;	/**< The item, in the pool of the queue. */
+  unsigned gen;				/**< Generation of the slot at emplace.  */
+public:
+  ItemHandle(std::nullptr_t = nullptr) : pi(nullptr), gen(0) {}
+  ItemHandle(const PriorityItem<T, Pos, Key>* pi, unsigned gen) : pi(pi), gen(gen) {}
+  const PriorityItem<T, Pos, Key>* get() const { return pi; }
+  unsigned generation() const { return gen; }
+  const PriorityItem<T, Pos, Key>* operator->() const { return pi; }
+  const PriorityItem<T, Pos, Key>& operator*() const { return *pi; }
+  explicit operator bool() const { return pi != nullptr; }
+  bool operator==(const ItemHandle& o) const { return pi == o.pi && gen == o.gen; }
+  bool operator!=(const ItemHandle& o) const { return !(*this == o); }
+};
+
+/**
+ * Output iterator that ignores what is written, for the operations with an
+ * optional output (as the handles of merge).
+ */
+struct DiscardOutput {
+  DiscardOutput& operator*() { return *this; }
+  DiscardOutput& operator++() { return *this; }
+  DiscardOutput operator++(int) { return *this; }
+  template <class X>
+  DiscardOutput& operator=(const X&) { return *this; }
+};
+
+/**
+ * Layout policy: the heap is an array of pointers to the PriorityItems.
+ *
+ * Every comparison during a restore dereferences a pointer to read the
+ * priority, and every item moved writes its new position in the item itself.
+ * It is the most compact layout (one pointer per slot).
+ */
+struct PointerLayout {
+  template <class T, class Pos, class Key = py_t> class Heap;
+};
+
+/**
+ * Layout policy: the heap stores {priority, slot} pairs by value.
+ *
+ * Restores only touch the dense array of pairs; the PriorityItems are
+ * read only by min(). The position of an item is kept in a side table
+ * indexed by its slot in the pool (stored in PriorityItem::pos), so
+ * handles stay stable. Costs one pair and one index per slot.
+ */
+struct InlineLayout {
+  template <class T, class Pos, class Key = py_t> class Heap;
+};
+
+/**
+ * Layout policy: the pairs of InlineLayout, in blocks of PageBytes (a page
+ * of memory, or a cache line) that each hold a whole sub-tree ("B-heap").
+ * The array is aligned to PageBytes and every block starts a new page, so
+ * a sub-tree never crosses a page boundary.
+ *
+ * Every block holds the children of a node and their descendants for as
+ * many levels as fit, so a restore touches a new block only every few
+ * levels: O(log_B(n)) pages (and TLB entries) instead of O(log(n)).
+ * The children of a node are still contiguous, so the vectorized
+ * minimum of the children works as with InlineLayout. It's faster only
+ * when the heap is much bigger than the caches (see the benchmark suite).
+ */
+template <std::size_t PageBytes = 4096>
+struct BlockLayout {
+  template <class T, class Pos, class Key = py_t, unsigned Arity = 2> class Heap;
+};
+
+template <class T, class Pos, class Key>
+class PointerLayout::Heap {
+private:
+  PriorityItem<T, Pos, Key>** heap; 	/**< minHeap (array of pointers).              */
+  ItemPool<PriorityItem<T, Pos, Key>, Pos> pool; /**< Slots of the items, owned by the heap. */
+public:
+  Heap(Pos);
+  ~Heap();
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+  static const unsigned keyStride = 0; /**< Priorities are not contiguous. */
+  typedef PriorityItem<T, Pos, Key>* Entry; /**< What is moved in the heap array. */
+  static const Key& key(const Entry& e) { return e->priority; }
+  Entry get(Pos i) const { return heap[i]; }
+  void put(Pos i, const Entry& e) { heap[i] = e; e->pos = i; }
+  const Key& priority(Pos i) const { return heap[i]->priority; }
+  PriorityItem<T, Pos, Key>* item(Pos i) const { return heap[i]; }
+  Pos position(const PriorityItem<T, Pos, Key>* pi) const { return pi->pos; }
+  void setPriority(Pos i, const Key& priority) { heap[i]->priority = priority; }
+  template <class... Args>
+  PriorityItem<T, Pos, Key>* construct(Pos, const Key&, Args&&...);
+  static unsigned generation(const PriorityItem<T, Pos, Key>* pi) { return ItemPool<PriorityItem<T, Pos, Key>, Pos>::generation(pi); }
+  void destroy(Pos i) { heap[i]->~PriorityItem<T, Pos, Key>(); pool.retire(heap[i]); }
+  void swap(Pos, Pos);
+  void grow(Pos, Pos);
+};
+
+template <class T, class Pos, class Key>
+class InlineLayout::Heap {
+private:
+public:
+  struct Entry {
+    Key priority;  /**< Copy of the priority of the item.  */
+    Pos slot;      /**< Slot of the item in the pool.      */
+  };
+private:
+  Entry* heap;			/**< minHeap (array of pairs).                 */
+  Pos* index;			/**< Position in heap of every slot.           */
+  ItemPool<PriorityItem<T, Pos, Key>, Pos> pool; /**< Slots of the items, owned by the heap. */
+public:
+  Heap(Pos);
+  ~Heap();
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+  /** Distance (in Key) between the priorities of two consecutive pairs. */
+  static const unsigned keyStride = sizeof(Entry) % sizeof(Key) ? 0 : sizeof(Entry) / sizeof(Key);
+  const Key* keys(Pos i) const { return &heap[i].priority; }
+  static const Key& key(const Entry& e) { return e.priority; }
+  Entry get(Pos i) const { return heap[i]; }
+  void put(Pos i, const Entry& e) { heap[i] = e; index[e.slot] = i; }
+  const Key& priority(Pos i) const { return heap[i].priority; }
+  PriorityItem<T, Pos, Key>* item(Pos i) const { return pool.at(heap[i].slot); }
+  Pos position(const PriorityItem<T, Pos, Key>* pi) const { return index[pi->pos]; }
+  void setPriority(Pos i, const Key& priority) { heap[i].priority = item(i)->priority = priority; }
+  template <class... Args>
+  PriorityItem<T, Pos, Key>* construct(Pos, const Key&, Args&&...);
+  static unsigned generation(const PriorityItem<T, Pos, Key>* pi) { return ItemPool<PriorityItem<T, Pos, Key>, Pos>::generation(pi); }
+  void destroy(Pos i) { item(i)->~PriorityItem<T, Pos, Key>(); pool.retire(item(i)); }
+  void swap(Pos, Pos);
+  void grow(Pos, Pos);
+};
+
+/**
+ * Shape of the heap: the usual one, where the children of (i) are at
+ * Arity*i + 1 and after, level after level.
+ */
+template <unsigned Arity>
+struct LevelShape {
+  static const bool levelOrder = true; /**< If every level is a contiguous range. */
+  static const std::size_t nodes = 0;  /**< Nodes in a block: no blocks.         */
+  static constexpr std::size_t parent(std::size_t i) { return (i-1) / Arity; }
+  static constexpr std::size_t firstChild(std::size_t i) { return Arity*i + 1; }
+  static constexpr std::size_t lastParent(std::size_t size) { return (size-2) / Arity; }
+};
+
+/**
+ * Shape of a B-heap: the root is alone at zero, then blocks of Entries
+ * pairs. A block holds Levels levels of a forest of Arity sub-trees:
+ * the children of one node of the block above (BFS order in the block).
+ * The children of a node in the last level of a block are the first
+ * level of a child block; the blocks are numbered in BFS order too, so a
+ * parent is always before its children and the heap is the prefix [0, size).
+ */
+template <unsigned Arity, unsigned Levels>
+struct BlockShape {
+  static const bool levelOrder = false;
+  static constexpr std::size_t power(unsigned e) { return e ? Arity * power(e-1) : 1; }
+  static const std::size_t width = power(Levels);			/**< Nodes in the last level of a block. */
+  static const std::size_t nodes = Arity * (width - 1) / (Arity - 1);	/**< Nodes in a block.  */
+  static const std::size_t bottom = nodes - width;			/**< Offset of the last level. */
+  static std::size_t parent(std::size_t i) {
+    std::size_t block = (i-1) / nodes, offset = (i-1) % nodes;
+    if (offset >= Arity) // in the same block
+      return 1 + block*nodes + offset/Arity - 1;
+    if (block == 0)
+      return 0; // the root
+    return 1 + ((block-1) / width)*nodes + bottom + (block-1) % width; // in the parent block
+  }
+  static std::size_t firstChild(std::size_t i) {
+    if (i == 0)
+      return 1;
+    std::size_t block = (i-1) / nodes, offset = (i-1) % nodes;
+    if (offset < bottom) // in the same block
+      return 1 + block*nodes + Arity*offset + Arity;
+    return 1 + (block*width + offset - bottom + 1) * nodes; // the first level of a child block
+  }
+  static std::size_t lastParent(std::size_t size) { return size-2; } // not exact, the loops skip the leaves
+};
+
+/**
+ * Number of levels of a block: as many as fit in (entries) pairs, at least one.
+ */
+constexpr unsigned blockLevels(std::size_t arity, std::size_t entries, unsigned levels, std::size_t row, std::size_t total) {
+  return total + row*arity > entries ? levels : blockLevels(arity, entries, levels+1, row*arity, total + row*arity);
+}
+
+constexpr unsigned blockLevels(std::size_t arity, std::size_t entries) {
+  return blockLevels(arity, entries, 1, arity, arity);
+}
+
+/**
+ * Shape of the tree used by a layout: LevelShape, except for BlockLayout.
+ */
+template <class Layout, unsigned Arity, std::size_t EntryBytes>
+struct LayoutShape {
+  typedef LevelShape<Arity> type;
+};
+
+template <std::size_t PageBytes, unsigned Arity, std::size_t EntryBytes>
+struct LayoutShape<BlockLayout<PageBytes>, Arity, EntryBytes> {
+  typedef BlockShape<Arity, blockLevels(Arity, PageBytes / EntryBytes)> type;
+};
+
+/**
+ * Storage of the heap used by a layout: its Heap, with the arity for
+ * BlockLayout (the size of a block depends on it).
+ */
+template <class Layout, class T, class Pos, class Key, unsigned Arity>
+struct LayoutStorage {
+  typedef typename Layout::template Heap<T, Pos, Key> type;
+};
+
+template <std::size_t PageBytes, class T, class Pos, class Key, unsigned Arity>
+struct LayoutStorage<BlockLayout<PageBytes>, T, Pos, Key, Arity> {
+  typedef typename BlockLayout<PageBytes>::template Heap<T, Pos, Key, Arity> type;
+};
+
+/**
+ * A block layout stores the same pairs and index of InlineLayout, only the
+ * place of a position in memory is different: the blocks of the shape are
+ * padded to a whole number of pages, from a page boundary, and the root is
+ * alone in the last pair of the page before the first block.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+class BlockLayout<PageBytes>::Heap {
+public:
+  typedef typename InlineLayout::Heap<T, Pos, Key>::Entry Entry;
+private:
+  static_assert(PageBytes % alignof(Entry) == 0, "a page must be aligned for the pairs");
+  static const std::size_t nodes = LayoutShape<BlockLayout, Arity, sizeof(Entry)>::type::nodes; /**< Pairs in a block. */
+  static const std::size_t stride = (nodes * sizeof(Entry) + PageBytes - 1) / PageBytes * PageBytes; /**< Bytes of a block. */
+  void* raw;			/**< Memory of the array.                      */
+  char* blocks;			/**< First block, on a page boundary.          */
+  Pos capacity;			/**< Number of pairs.                          */
+  Pos* index;			/**< Position in heap of every slot.           */
+  ItemPool<PriorityItem<T, Pos, Key>, Pos> pool; /**< Slots of the items, owned by the heap. */
+  static Entry& at(char* blocks, std::size_t i) {
+    if (i == 0)
+      return reinterpret_cast<Entry*>(blocks)[-1]; // the root
+    return reinterpret_cast<Entry*>(blocks + (i-1) / nodes * stride)[(i-1) % nodes];
+  }
+  Entry& at(std::size_t i) const { return at(blocks, i); }
+  static char* allocate(Pos, void*&);
+  static void release(void*, char*, Pos);
+public:
+  Heap(Pos);
+  ~Heap();
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+  static const unsigned keyStride = InlineLayout::Heap<T, Pos, Key>::keyStride;
+  const Key* keys(Pos i) const { return &at(i).priority; }
+  static const Key& key(const Entry& e) { return e.priority; }
+  Entry get(Pos i) const { return at(i); }
+  void put(Pos i, const Entry& e) { at(i) = e; index[e.slot] = i; }
+  const Key& priority(Pos i) const { return at(i).priority; }
+  PriorityItem<T, Pos, Key>* item(Pos i) const { return pool.at(at(i).slot); }
+  Pos position(const PriorityItem<T, Pos, Key>* pi) const { return index[pi->pos]; }
+  void setPriority(Pos i, const Key& priority) { at(i).priority = item(i)->priority = priority; }
+  template <class... Args>
+  PriorityItem<T, Pos, Key>* construct(Pos, const Key&, Args&&...);
+  static unsigned generation(const PriorityItem<T, Pos, Key>* pi) { return ItemPool<PriorityItem<T, Pos, Key>, Pos>::generation(pi); }
+  void destroy(Pos i) { item(i)->~PriorityItem<T, Pos, Key>(); pool.retire(item(i)); }
+  void swap(Pos, Pos);
+  void grow(Pos, Pos);
+};
+
+/**
+ * Kernel for the index of the minimum of N priorities, stored every Stride keys
+ * (of the maximum, if Greatest: the first for std::greater).
+ *
+ * This generic version is not vectorized; the specializations below use
+ * SSE4.1 (4 children), AVX2 (8) or AVX-512 (16) when they are enabled at
+ * compile time, on pairs of 8 bytes starting with a 32 bits unsigned priority
+ * (Stride 2, the InlineLayout with the default types) compared with
+ * std::less or std::greater.
+ * Define BINHEAPPQ_NO_SIMD to always use the scalar code.
+ */
+template <unsigned N, unsigned Stride, bool Greatest = false>
+struct MinKernel {
+  static const bool vectorized = false;
+};
+
+#ifdef BINHEAPPQ_SIMD
+#ifdef __SSE4_1__
+template <bool Greatest>
+struct MinKernel<4, 2, Greatest> {
+  static const bool vectorized = true;
+  static __m128i best(__m128i a, __m128i b) { return Greatest ? _mm_max_epu32(a, b) : _mm_min_epu32(a, b); }
+  static unsigned index(const unsigned int* keys) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 4));
+    __m128i v = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2,0,2,0)));
+    __m128i m = best(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+    m = best(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+    return __builtin_ctz(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, m))));
+  }
+};
+#endif
+
+#ifdef __AVX2__
+template <bool Greatest>
+struct MinKernel<8, 2, Greatest> {
+  static const bool vectorized = true;
+  static __m256i best(__m256i a, __m256i b) { return Greatest ? _mm256_max_epu32(a, b) : _mm256_min_epu32(a, b); }
+  static unsigned index(const unsigned int* keys) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + 8));
+    // even lanes of (a, b), then fix the order of the 64 bits blocks
+    __m256i v = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2,0,2,0)));
+    v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3,1,2,0));
+    __m256i m = best(v, _mm256_permute2x128_si256(v, v, 1));
+    m = best(m, _mm256_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+    m = best(m, _mm256_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+    return __builtin_ctz(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, m))));
+  }
+};
+#endif
+
+#ifdef __AVX512F__
+template <bool Greatest>
+struct MinKernel<16, 2, Greatest> {
+  static const bool vectorized = true;
+  static unsigned index(const unsigned int* keys) {
+    __m512i a = _mm512_loadu_si512(keys);
+    __m512i b = _mm512_loadu_si512(keys + 16);
+    __m512i even = _mm512_set_epi32(30,28,26,24,22,20,18,16,14,12,10,8,6,4,2,0);
+    __m512i v = _mm512_permutex2var_epi32(a, even, b);
+    __m512i m = _mm512_set1_epi32(Greatest ? _mm512_reduce_max_epu32(v) : _mm512_reduce_min_epu32(v));
+    return __builtin_ctz(_mm512_cmpeq_epu32_mask(v, m));
+  }
+};
+#endif
+#endif
+
+/**
+ * What the code can assume about the priorities, at compile time.
+ *
+ * Arithmetic keys compared by std::less or std::greater are copied and
+ * selected with conditional moves instead of branches; 32 bits unsigned
+ * keys compared by std::less or std::greater can use the vectorized kernels.
+ */
+template <class Key, class Compare>
+struct KeyTraits {
+  static constexpr bool branchless = std::is_arithmetic<Key>::value
+    && (std::is_same<Compare, std::less<Key> >::value || std::is_same<Compare, std::greater<Key> >::value);
+  static constexpr bool vectorized = std::is_same<Key, unsigned int>::value
+    && (std::is_same<Compare, std::less<unsigned int> >::value || std::is_same<Compare, std::greater<unsigned int> >::value);
+};
+
+/**
+ * Holder of the comparator of the priorities: an empty (stateless) one is
+ * a base class, so it takes no space (empty base optimization).
+ */
+template <class Compare, bool = std::is_empty<Compare>::value>
+class KeyCompare : private Compare {
+public:
+  KeyCompare(const Compare& compare) : Compare(compare) {}
+  const Compare& compare() const { return *this; }
+};
+
+template <class Compare>
+class KeyCompare<Compare, false> {
+private:
+  Compare comparator; /**< The comparator, with a state. */
+public:
+  KeyCompare(const Compare& compare) : comparator(compare) {}
+  const Compare& compare() const { return comparator; }
+};
+
+/**
+ * Snapshot of the statistics of a queue.
+ *
+ * The latency of the operation (op) is a histogram: latency[op][b] counts
+ * the calls which took [2^b, 2^(b+1)) nanoseconds (the last bucket also more).
+ */
+struct PQStats {
+  enum Op { EMPLACE, DELETE_MIN, DECREASE, INCREASE, ERASE, GROW, OPS };
+  static const unsigned BUCKETS = 32;
+  std::uint64_t upIterations;		/**< Levels climbed by upRestore.          */
+  std::uint64_t downIterations;		/**< Levels descended by downRestore.      */
+  std::uint64_t swaps;			/**< Entries moved in the heap array.      */
+  std::uint64_t rejections;		/**< emplace calls on a full queue.        */
+  std::uint64_t peakSize;		/**< Maximum size reached.                 */
+  std::uint64_t latency[OPS][BUCKETS];	/**< Histograms of the latencies, or zero. */
+};
+
+/**
+ * Stats policy of BinHeapPQ which counts nothing: every hook is empty,
+ * so with it the queue is exactly as fast as without the hooks.
+ */
+class NoStats {
+public:
+  struct Stamp {};
+  void siftUp() {}
+  void siftDown() {}
+  void swap() {}
+  void rejected() {}
+  void resized(std::size_t) {}
+  Stamp start() { return Stamp(); }
+  void stop(PQStats::Op, Stamp) {}
+  PQStats snapshot() const { return PQStats(); }
+  void reset() {}
+};
+
+/**
+ * Stats policy of BinHeapPQ which counts the iterations of the restores,
+ * the swaps, the rejections and the peak size (not the latencies).
+ */
+class CountStats : public NoStats {
+protected:
+  PQStats counters; /**< The counters, the latencies stay zero. */
+public:
+  CountStats() : counters() {}
+  void siftUp() { counters.upIterations++; }
+  void siftDown() { counters.downIterations++; }
+  void swap() { counters.swaps++; }
+  void rejected() { counters.rejections++; }
+  void resized(std::size_t size) { if (size > counters.peakSize) counters.peakSize = size; }
+  PQStats snapshot() const { return counters; }
+  void reset() { counters = PQStats(); }
+};
+
+/**
+ * Stats policy of BinHeapPQ which counts as CountStats and also takes
+ * the latency of every operation (two reads of the steady clock).
+ */
+class TimedStats : public CountStats {
+public:
+  typedef std::chrono::steady_clock::time_point Stamp;
+  Stamp start() { return std::chrono::steady_clock::now(); }
+  void stop(PQStats::Op op, Stamp start) {
+    std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    unsigned b = 0;
+    while ((ns >>= 1) && b < PQStats::BUCKETS-1)
+      b++;
+    counters.latency[op][b]++;
+  }
 };
 
+/**
+ * Select the position of the minimum of the children in [first, last),
+ * with a kernel if there is one for the arity, the layout and the keys,
+ * with a branchless scalar loop for the arithmetic keys, or with a generic loop.
+ */
+template <unsigned Arity, unsigned Stride, class Key, class Compare,
+  int = (KeyTraits<Key, Compare>::vectorized && MinKernel<Arity, Stride>::vectorized) ? 2
+      : KeyTraits<Key, Compare>::branchless ? 1 : 0>
+struct ChildSelect {
+  template <class Heap>
+  static std::size_t min(const Heap& heap, const Compare& less, std::size_t first, std::size_t last) {
+    std::size_t min = first;
+    for (std::size_t c = first+1; c < last; c++)
+      if (less(heap.priority(c), heap.priority(min))) min = c;
+    return min;
+  }
+};
+
+template <unsigned Arity, unsigned Stride, class Key, class Compare>
+struct ChildSelect<Arity, Stride, Key, Compare, 1> {
+  template <class Heap>
+  static std::size_t min(const Heap& heap, const Compare& less, std::size_t first, std::size_t last) {
+    std::size_t min = first;
+    Key best = heap.priority(first);
+    for (std::size_t c = first+1; c < last; c++) {
+      Key key = heap.priority(c);
+      bool lesser = less(key, best);
+      min = lesser ? c : min;
+      best = lesser ? key : best;
+    }
+    return min;
+  }
+};
+
+template <unsigned Arity, unsigned Stride, class Key, class Compare>
+struct ChildSelect<Arity, Stride, Key, Compare, 2> {
+  template <class Heap>
+  static std::size_t min(const Heap& heap, const Compare& less, std::size_t first, std::size_t last) {
+    if (last - first < Arity) // partial node, the last one of the heap
+      return ChildSelect<Arity, Stride, Key, Compare, 1>::min(heap, less, first, last);
+    return first + MinKernel<Arity, Stride, std::is_same<Compare, std::greater<Key> >::value>::index(heap.keys(first));
+  }
+};
+
+class PQSnapshot;
+class PQParallel;
+
 /**
  * Unstable priority queue, static dimension, implemented with a heap structure.
+ * (StableHeapPQ, in StableHeapPQ.cpp, deletes the equal priorities in FIFO order.)
+ *
+ * The Layout policy (PointerLayout or InlineLayout) chooses how the heap
+ * array is stored; the interface and the handles are the same.
+ * Arity is the fan-out of the heap (2 for a binary heap): a wider heap is
+ * shallower, so emplace and decrease are cheaper, while deleteMin and
+ * increase compare more children at every level.
+ * Pos is the unsigned integer type of positions and sizes; it limits the
+ * number of items (pos_t by default, 32 or 64 bits for bigger queues).
+ * Key is the type of the priorities (py_t by default) and Compare orders
+ * them: the "minimum" is the first for Compare, so std::greater gives a
+ * max-heap; "decrease" always moves an item towards the top.
+ * The Stats policy (NoStats, CountStats or TimedStats) collects the
+ * statistics of the restores and of the operations, read by stats().
+ * A growable queue doubles its capacity when it's full instead of refusing
+ * new items; the items are never moved, so the handles stay valid.
  *
  * |------------------------------|---------------------------|
- * | Get min 		O(1)   	  | Init 		O(1)  |
+ * | Get min 		O(1)   	  | Init 		O(n)  |
  * | "Is empty?" 	O(1)	  | Destroy 		O(n)  |
  * | Emplace new item 	O(log(n)) | Mem        		O(n)  |
- * | De/In-crease key 	O(log(n)) |---------------------------|
- * | Delete min 	O(log(n)) |
- * |------------------------------|
+ * | De/In-crease key 	O(log(n)) | Assign (heapify)	O(n)  |
+ * | Delete min 	O(log(n)) | Erase item		O(log(n)) |
+ * |------------------------------| Merge			O(n+m) |
+ * 				  |---------------------------|
  */
-template <class T>
-class BinHeapPQ {
+template <class T, class Layout = PointerLayout, unsigned Arity = 2, class Pos = pos_t,
+          class Key = py_t, class Compare = std::less<Key>, class Stats = NoStats>
+class BinHeapPQ : private KeyCompare<Compare>, private Stats {
+  static_assert(Arity >= 2, "the arity of the heap must be at least 2");
+  static_assert(std::is_unsigned<Pos>::value, "the position type must be unsigned");
+  friend class PQSnapshot; // see PQSnapshot.cpp
+  friend class PQParallel; // see PQParallel.cpp
+public:
+  typedef Pos Size;				/**< Type of positions and sizes.      */
+  typedef Key Priority;				/**< Type of the priorities.           */
+  typedef Compare Comparator;			/**< Order of the priorities.          */
+  typedef ItemHandle<T, Pos, Key> Handle;	/**< Checked read-only pointer to an item. */
 private:
-  pos_t maxSize;		/**< Max number of element stored in heap.     */
-  pos_t size;			/**< Current size (number of element) of heap. */
-  PriorityItem<T>** heap; 	/**< minHeap (array of pointers).              */
+  typedef typename LayoutStorage<Layout, T, Pos, Key, Arity>::type Storage;
+  Pos maxSize;			/**< Max number of element stored in heap.     */
+  Pos size;			/**< Current size (number of element) of heap. */
+  bool growable;		/**< If the capacity grows when it's full.     */
+  Storage heap;			/**< minHeap and its storage.                  */
+  typedef typename LayoutShape<Layout, Arity, sizeof(typename Storage::Entry)>::type Shape;
   // private function for internal use
-  void swap(PriorityItem<T>* &, PriorityItem<T>* &);
-  void upRestore(pos_t);
-  void downRestore(pos_t);
+  bool less(const Key& a, const Key& b) const { return this->compare()(a, b); }
+  static std::size_t parent(std::size_t i) { return Shape::parent(i); }
+  static std::size_t firstChild(std::size_t i) { return Shape::firstChild(i); }
+  std::size_t minChild(std::size_t, std::size_t) const;
+  void upRestore(Pos);
+  void downRestore(Pos);
+  void heapify();
+  void mergeRestore(std::size_t);
+  void batchRestore(Pos);
+  bool grow();
 public:
-  BinHeapPQ(pos_t);
+  BinHeapPQ(Pos, bool = false, const Compare& = Compare());
   ~BinHeapPQ();
   bool isEmpty();
   bool isFull();
+  void reserve(Pos);
   T min(); // throw an exception if heap is empty
-  //TODO is the item was deleted, the pointer is unsafe
-  const PriorityItem<T>* emplace(py_t, T);
-  void decrease(py_t, const PriorityItem<T>*);
-  void increase(py_t, const PriorityItem<T>*); 
+  const T& top(); // throw an exception if heap is empty
+  const Key& minPriority(); // throw an exception if heap is empty
+  Handle minHandle(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(const Key&, Args&&...);
+  template <class... Args>
+  Handle replaceMin(const Key&, Args&&...); // throw an exception if heap is empty
+  template <class... Args>
+  T pushPop(const Key&, Args&&...);
+  bool contains(Handle);
+  void decrease(const Key&, Handle);
+  void increase(const Key&, Handle);
+  bool erase(Handle);
   void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+  void clear();
+  template <class InputIt>
+  Pos assign(InputIt, InputIt);
+  template <class InputIt, class OutputIt>
+  Pos assign(InputIt, InputIt, OutputIt);
+  template <class InputIt>
+  Pos emplaceBatch(InputIt, InputIt);
+  Pos merge(BinHeapPQ&&);
+  template <class OutputIt>
+  Pos merge(BinHeapPQ&&, OutputIt);
+  template <class OutputIt>
+  Pos popMin(Pos, OutputIt);
+  template <class Update>
+  Pos rebuild(Update);
+  PQStats stats() const;
+  void resetStats();
+  const Compare& comparator() const { return this->compare(); }
 };
 
 /**
- * Init the priority queue. O(1).
+ * A d-ary heap is just a BinHeapPQ with a different arity.
+ */
+template <class T, unsigned Arity, class Layout = PointerLayout, class Pos = pos_t,
+          class Key = py_t, class Compare = std::less<Key>, class Stats = NoStats>
+using DAryHeapPQ = BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>;
+
+/**
+ * Allocate the first chunk of slots, for (at least) the capacity given. O(1).
+ *
+ * @param capacity The initial number of slots.
+ */
+template <class Item, class Pos>
+ItemPool<Item, Pos>::ItemPool(Pos capacity) {
+  shift = 0;
+  while ((std::size_t(1) << shift) < std::size_t(capacity))
+    shift++;
+  chunks.push_back(allocate(std::size_t(1) << shift));
+}
+
+/**
+ * Allocate a chunk of slots, all at generation zero. O(n).
+ *
+ * @param n The number of slots.
+ * @return The chunk.
+ */
+template <class Item, class Pos>
+typename ItemPool<Item, Pos>::Slot* ItemPool<Item, Pos>::allocate(std::size_t n) {
+  Slot* chunk = new Slot[n];
+  for (std::size_t i=0; i < n; i++)
+    chunk[i].generation = 0;
+  return chunk;
+}
+
+/**
+ * Release the memory; the items still stored must be already destroyed.
+ */
+template <class Item, class Pos>
+ItemPool<Item, Pos>::~ItemPool() {
+  for (std::size_t c=0; c < chunks.size(); c++)
+    delete[] chunks[c];
+}
+
+/**
+ * Add chunks, each one doubling the capacity, until there are (at least)
+ * the slots requested. O(1) per chunk, O(log(n)) chunks.
+ *
+ * @param capacity The number of slots needed.
+ */
+template <class Item, class Pos>
+void ItemPool<Item, Pos>::grow(Pos capacity) {
+  while (this->capacity() < std::size_t(capacity))
+    chunks.push_back(allocate(this->capacity()));
+}
+
+/**
+ * Move the chunk of another pool after the ones of this pool. O(1).
+ *
+ * The items (and their generations) aren't moved, so the pointers stay
+ * valid; the slot (s) of the other pool becomes the slot (s + capacity())
+ * of this one. The other pool is left with a new, empty chunk.
+ * The chunk adopted must be the next one of this pool: the other pool
+ * never grew and its chunk is as big as this capacity (as two pools with
+ * the same initial capacity, this one never grown).
+ * Only PairingHeapPQ::merge adopts pools; BinHeapPQ::merge moves the values.
+ *
+ * @param other The pool adopted.
+ * @return False (and nothing is done) if the chunk of the other pool can't be the next one.
+ */
+template <class Item, class Pos>
+bool ItemPool<Item, Pos>::adopt(ItemPool& other) {
+  if (other.chunks.size() != 1 || (std::size_t(1) << other.shift) != capacity())
+    return false;
+  chunks.push_back(other.chunks[0]);
+  other.chunks[0] = allocate(std::size_t(1) << other.shift);
+  return true;
+}
+
+/**
+ * Allocate the array of pointers and the pool of (raw, unconstructed) slots. O(n).
+ *
+ * Slots are recycled through the tail of the heap array: the pointers in
+ * heap[size..maxSize) always refer to the free slots of the pool, so
+ * emplace and deleteMin never call the allocator.
+ *
+ * @param maxSize The maximum size (number of items).
+ */
+template <class T, class Pos, class Key>
+PointerLayout::Heap<T, Pos, Key>::Heap(Pos maxSize) : pool(maxSize) {
+  heap = new PriorityItem<T, Pos, Key>*[maxSize];
+  for (Pos i=0; i < maxSize; i++)
+    heap[i] = pool.at(i); // every slot starts free
+}
+
+/**
+ * Release the memory; the items still stored must be already destroyed.
+ */
+template <class T, class Pos, class Key>
+PointerLayout::Heap<T, Pos, Key>::~Heap() {
+  delete[] heap;
+}
+
+/**
+ * Enlarge the array of pointers and the pool; the items are not moved. O(n).
+ *
+ * @param oldSize The current maximum size.
+ * @param newSize The new maximum size.
+ */
+template <class T, class Pos, class Key>
+void PointerLayout::Heap<T, Pos, Key>::grow(Pos oldSize, Pos newSize) {
+  pool.grow(newSize);
+  PriorityItem<T, Pos, Key>** newHeap = new PriorityItem<T, Pos, Key>*[newSize];
+  std::copy(heap, heap + oldSize, newHeap); // with the free slots after size
+  for (Pos i = oldSize; i < newSize; i++)
+    newHeap[i] = pool.at(i);
+  delete[] heap;
+  heap = newHeap;
+}
+
+/**
+ * Construct a new item in the free slot referred by position (i). O(1).
+ *
+ * @param i The position, it must be the current size of the heap.
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return The item constructed.
+ */
+template <class T, class Pos, class Key>
+template <class... Args>
+PriorityItem<T, Pos, Key>* PointerLayout::Heap<T, Pos, Key>::construct(Pos i, const Key& priority, Args&&... args) {
+  return new (heap[i]) PriorityItem<T, Pos, Key>(priority, i, std::forward<Args>(args)...);
+}
+
+/** 
+ * Swap two PriorityItems in heap, updating their position. O(1).
+ *
+ * @param a The position of the first.
+ * @param b The position of the second.
+ */
+template <class T, class Pos, class Key>
+void PointerLayout::Heap<T, Pos, Key>::swap(Pos a, Pos b) {
+  PriorityItem<T, Pos, Key>* tmp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = tmp;
+  heap[a]->pos = a; // positions must be updated
+  heap[b]->pos = b;
+}
+
+/**
+ * Allocate the array of pairs, the index and the slab of slots. O(n).
+ *
+ * As in PointerLayout, the pairs in heap[size..maxSize) refer to the free slots.
+ *
+ * @param maxSize The maximum size (number of items).
+ */
+template <class T, class Pos, class Key>
+InlineLayout::Heap<T, Pos, Key>::Heap(Pos maxSize) : pool(maxSize) {
+  heap = new Entry[maxSize];
+  index = new Pos[maxSize];
+  for (Pos i=0; i < maxSize; i++) {
+    heap[i].slot = i; // every slot starts free
+    index[i] = i;
+  }
+}
+
+/**
+ * Release the memory; the items still stored must be already destroyed.
+ */
+template <class T, class Pos, class Key>
+InlineLayout::Heap<T, Pos, Key>::~Heap() {
+  delete[] index;
+  delete[] heap;
+}
+
+/**
+ * Enlarge the array of pairs, the index and the pool; the items are not moved. O(n).
+ *
+ * @param oldSize The current maximum size.
+ * @param newSize The new maximum size.
+ */
+template <class T, class Pos, class Key>
+void InlineLayout::Heap<T, Pos, Key>::grow(Pos oldSize, Pos newSize) {
+  pool.grow(newSize);
+  Entry* newHeap = new Entry[newSize];
+  Pos* newIndex = new Pos[newSize];
+  std::copy(heap, heap + oldSize, newHeap); // with the free slots after size
+  std::copy(index, index + oldSize, newIndex);
+  for (Pos i = oldSize; i < newSize; i++) {
+    newHeap[i].slot = i;
+    newIndex[i] = i;
+  }
+  delete[] index;
+  delete[] heap;
+  heap = newHeap;
+  index = newIndex;
+}
+
+/**
+ * Construct a new item in the free slot referred by position (i). O(1).
+ *
+ * @param i The position, it must be the current size of the heap.
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return The item constructed.
+ */
+template <class T, class Pos, class Key>
+template <class... Args>
+PriorityItem<T, Pos, Key>* InlineLayout::Heap<T, Pos, Key>::construct(Pos i, const Key& priority, Args&&... args) {
+  heap[i].priority = priority;
+  return new (pool.at(heap[i].slot)) PriorityItem<T, Pos, Key>(priority, heap[i].slot, std::forward<Args>(args)...);
+}
+
+/** 
+ * Swap two pairs in heap, updating the index. O(1).
+ *
+ * @param a The position of the first.
+ * @param b The position of the second.
+ */
+template <class T, class Pos, class Key>
+void InlineLayout::Heap<T, Pos, Key>::swap(Pos a, Pos b) {
+  Entry tmp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = tmp;
+  index[heap[a].slot] = a;
+  index[heap[b].slot] = b;
+}
+
+/**
+ * Allocate the pages for (capacity) pairs, and construct the pairs. O(n).
+ *
+ * @param capacity The number of pairs.
+ * @param raw Where the memory allocated is written, for release.
+ * @return The first block, on a page boundary after the page of the root.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+char* BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::allocate(Pos capacity, void*& raw) {
+  std::size_t count = capacity > 1 ? (std::size_t(capacity) - 2) / nodes + 1 : 0; // blocks of [1, capacity)
+  raw = ::operator new(PageBytes - 1 + PageBytes + count * stride);
+  std::size_t first = (reinterpret_cast<std::size_t>(raw) + PageBytes - 1) / PageBytes * PageBytes + PageBytes;
+  char* blocks = reinterpret_cast<char*>(first);
+  for (std::size_t i=0; i < capacity; i++)
+    new (&at(blocks, i)) Entry();
+  return blocks;
+}
+
+/**
+ * Destroy the pairs and release the pages of allocate. O(n).
+ *
+ * @param raw The memory allocated.
+ * @param blocks The first block.
+ * @param capacity The number of pairs.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+void BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::release(void* raw, char* blocks, Pos capacity) {
+  for (std::size_t i=0; i < capacity; i++)
+    at(blocks, i).~Entry();
+  ::operator delete(raw);
+}
+
+/**
+ * Allocate the pages of the pairs, the index and the slab of slots. O(n).
+ *
+ * As in InlineLayout, the pairs in heap[size..maxSize) refer to the free slots.
  *
- * @param maxSize The maximum size (number of items) you want to.
+ * @param maxSize The maximum size (number of items).
  */
-template <class T>
-BinHeapPQ<T>::BinHeapPQ(pos_t maxSize) {
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::Heap(Pos maxSize) : capacity(maxSize), pool(maxSize) {
+  blocks = allocate(maxSize, raw);
+  index = new Pos[maxSize];
+  for (Pos i=0; i < maxSize; i++) {
+    at(i).slot = i; // every slot starts free
+    index[i] = i;
+  }
+}
+
+/**
+ * Release the memory; the items still stored must be already destroyed.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::~Heap() {
+  delete[] index;
+  release(raw, blocks, capacity);
+}
+
+/**
+ * Enlarge the pages of pairs, the index and the pool; the items are not moved. O(n).
+ *
+ * @param oldSize The current maximum size.
+ * @param newSize The new maximum size.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+void BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::grow(Pos oldSize, Pos newSize) {
+  pool.grow(newSize);
+  void* newRaw;
+  char* newBlocks = allocate(newSize, newRaw);
+  Pos* newIndex = new Pos[newSize];
+  for (Pos i=0; i < oldSize; i++)
+    at(newBlocks, i) = at(i); // with the free slots after size
+  std::copy(index, index + oldSize, newIndex);
+  for (Pos i = oldSize; i < newSize; i++) {
+    at(newBlocks, i).slot = i;
+    newIndex[i] = i;
+  }
+  delete[] index;
+  release(raw, blocks, capacity);
+  raw = newRaw;
+  blocks = newBlocks;
+  capacity = newSize;
+  index = newIndex;
+}
+
+/**
+ * Construct a new item in the free slot referred by position (i). O(1).
+ *
+ * @param i The position, it must be the current size of the heap.
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return The item constructed.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+template <class... Args>
+PriorityItem<T, Pos, Key>* BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::construct(Pos i, const Key& priority, Args&&... args) {
+  Entry& e = at(i);
+  e.priority = priority;
+  return new (pool.at(e.slot)) PriorityItem<T, Pos, Key>(priority, e.slot, std::forward<Args>(args)...);
+}
+
+/** 
+ * Swap two pairs in heap, updating the index. O(1).
+ *
+ * @param a The position of the first.
+ * @param b The position of the second.
+ */
+template <std::size_t PageBytes>
+template <class T, class Pos, class Key, unsigned Arity>
+void BlockLayout<PageBytes>::Heap<T, Pos, Key, Arity>::swap(Pos a, Pos b) {
+  Entry& x = at(a);
+  Entry& y = at(b);
+  Entry tmp = x;
+  x = y;
+  y = tmp;
+  index[x.slot] = a;
+  index[y.slot] = b;
+}
+
+/**
+ * Init the priority queue. O(n).
+ *
+ * All the memory needed is allocated here, once, by the layout;
+ * a growable queue allocates again only when it's full (or by reserve).
+ *
+ * @param maxSize The maximum size (number of items) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ * @param compare The comparator of the priorities.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::BinHeapPQ(Pos maxSize, bool growable, const Compare& compare)
+  : KeyCompare<Compare>(compare), heap(maxSize) {
   this->maxSize = maxSize;
+  this->growable = growable;
   size = 0;
-  heap = new PriorityItem<T>*[maxSize];
 }
 
-template <class T>
-BinHeapPQ<T>::~BinHeapPQ() { // O(size) <= O(n)
-  // de-allocate the dinamic heap
-  for (pos_t i=0; i < size; i++)
-    delete heap[i];
-  delete[] heap;
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::~BinHeapPQ() { // O(size) <= O(n)
+  clear(); // the layout releases the memory
 }
 
 /**
@@ -95,19 +1076,54 @@ BinHeapPQ<T>::~BinHeapPQ() { // O(size) <= O(n)
  *
  * @return True only if the current size is zero.
  */
-template <class T>
-bool BinHeapPQ<T>::isEmpty() {
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::isEmpty() {
   return (size == 0);
 }
 
 /**
  * Check if the priority queue id full. O(1).
  *
+ * A growable queue is full only when it can't grow anymore.
+ *
  * @return True only if the current size is the maximum size.
  */
-template <class T>
-bool BinHeapPQ<T>::isFull() {
-  return (size == maxSize);
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::isFull() {
+  return (size == maxSize) && !(growable && maxSize < std::numeric_limits<Pos>::max());
+}
+
+/**
+ * Function for enlarge the queue, so it can store (n) items without allocating. O(n).
+ *
+ * It works also if the queue isn't growable; it never shrinks the queue.
+ *
+ * @param n The number of items.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::reserve(Pos n) {
+  if (n <= maxSize)
+    return; // nothing to do
+  heap.grow(maxSize, n);
+  maxSize = n;
+}
+
+/**
+ * Double the capacity of a full growable queue. O(n), amortized O(1).
+ *
+ * @return False if the queue isn't growable or can't grow anymore.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::grow() {
+  if (!growable || maxSize == std::numeric_limits<Pos>::max())
+    return false;
+  typename Stats::Stamp start = Stats::start();
+  if (maxSize > std::numeric_limits<Pos>::max() / 2)
+    reserve(std::numeric_limits<Pos>::max());
+  else
+    reserve(maxSize > 0 ? 2*maxSize : 1);
+  Stats::stop(PQStats::GROW, start);
+  return true;
 }
 
 /**
@@ -119,27 +1135,55 @@ bool BinHeapPQ<T>::isFull() {
  *
  * @return The (copy) value associated.
  */
-template <class T>
-T BinHeapPQ<T>::min() {
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+T BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::min() {
   if (size > 0)
-    return heap[0]->item;
-  throw("Empty priority queue!"); //TODO use standard exception
+    return heap.item(0)->item;
+  throw std::out_of_range("Empty priority queue!");
 }
 
-/** 
- * Swap two PriorityItems in heap, updating their position. O(1).
+/**
+ * Function for get the minimum priority, without the value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+const Key& BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::minPriority() {
+  if (size > 0)
+    return heap.priority(0);
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get a reference to the minimum value, without copying it. O(1).
+ *
+ * The reference is valid until the item is deleted; if the queue is empty,
+ * it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+const T& BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::top() {
+  if (size > 0)
+    return heap.item(0)->item;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the handle of the minimum item. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
  *
- * @param a The first.
- * @param b The second.
+ * @return The handle of the item associated to the minimum priority.
  */
-template <class T>
-void BinHeapPQ<T>::swap(PriorityItem<T>* &a, PriorityItem<T>* &b) {
-  pos_t a_pos = a->pos, b_pos = b->pos; // positions must be preserved (and updated)
-  PriorityItem<T>* tmp = a;
-  a = b;
-  b = tmp;
-  a->pos = a_pos;
-  b->pos = b_pos;
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::minHandle() {
+  if (size > 0)
+    return Handle(heap.item(0), heap.generation(heap.item(0)));
+  throw std::out_of_range("Empty priority queue!");
 }
 
 /**
@@ -151,16 +1195,23 @@ void BinHeapPQ<T>::swap(PriorityItem<T>* &a, PriorityItem<T>* &b) {
  * Working only if the rest of heap is a valid/legal heap.
  * Because this function restore the heap from the element in (i) position
  * to the root (bottom-up), is complexity is O(h), where (h) is the height of heap;
- * beacuse we work with a binary tree, this function is O(log(n)).
+ * beacuse we work with a d-ary tree, this function is O(log_d(n)).
+ * The item is lifted out and its position is a "hole": the ancestors are
+ * moved down into the hole, and the item is written once, at the end.
  *
  * @param i The position of item to check/restore.
  */
-template <class T>
-void BinHeapPQ<T>::upRestore(pos_t i) {
-  while (i > 0 && heap[i]->priority < heap[i/2]->priority) {
-    swap(heap[i], heap[i/2]);
-    i /= 2;
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::upRestore(Pos i) {
+  typename Storage::Entry moving = heap.get(i);
+  const Key& priority = heap.key(moving);
+  while (i > 0 && less(priority, heap.priority(parent(i)))) {
+    heap.put(i, heap.get(parent(i))); // move the parent down, into the hole
+    i = parent(i);
+    Stats::siftUp();
+    Stats::swap();
   }
+  heap.put(i, moving);
 }
 
 /**
@@ -169,91 +1220,537 @@ void BinHeapPQ<T>::upRestore(pos_t i) {
  * If the PriorityItem in position (i) has a priority greater than his descendants,
  * due to different reasons (ie, his priority increased, or it was deleted),
  * this function look at his direct children and if one of them is lesser than it,
- * we swap them, and check, "recursively", the new position.
- * Working only if the rest of heap (aka the two sub-heap of children) is a legal heap.
+ * we move it up, and check, "recursively", the new position.
+ * As in upRestore, the item is kept out of the heap and written once, at the end.
+ * Working only if the rest of heap (aka the sub-heaps of children) is a legal heap.
  * Because this function restore the heap from the element in (i) position
- * to a "leaf" (top-down), is complexity is O(h), where (h) is the height of heap;
- * beacuse we work with a binary tree, this function is O(log(n)).
+ * to a "leaf" (top-down), is complexity is O(d*h), where (h) is the height of heap;
+ * beacuse we work with a d-ary tree, this function is O(d*log_d(n)).
  *
  * @param i The position of item to check/restore.
  */
-template <class T>
-void BinHeapPQ<T>::downRestore(pos_t i) {
-  while (i >= 0) { // condition for entering the loop
-    pos_t min = i; // the position of the minimum item between (i) and his children
-    if (2*i    < size)
-      if (heap[2*i]->priority    < heap[min]->priority) min = 2*i;
-    if (2*i +1 < size)
-      if (heap[2*i +1]->priority < heap[min]->priority) min = 2*i +1;
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::downRestore(Pos i) {
+  typename Storage::Entry moving = heap.get(i);
+  const Key& priority = heap.key(moving);
+  while (firstChild(i) < size) { // (i) has at least one child
+    std::size_t first = firstChild(i);
+    std::size_t last = (size - first > Arity) ? first + Arity : size;
+    std::size_t min = minChild(first, last); // the position of the minimum child
     
-    if (min != i) { // if (i) is not the minimum item
-      swap(heap[i], heap[min]);
+    if (less(heap.priority(min), priority)) { // if the item is not lesser than his children
+      heap.put(i, heap.get(min)); // move the child up, into the hole
       i = min; // update the position to check
+      Stats::siftDown();
+      Stats::swap();
     }
     else // nothing to do, heap is restored, exit
       break;
   }
+  heap.put(i, moving);
+}
+
+/**
+ * Position of the child with the minimum priority. O(d).
+ *
+ * The children in [first, last) are contiguous in the heap array; with
+ * InlineLayout and arity 4, 8 or 16 they are compared with a single
+ * vector compare-and-reduce (see MinKernel), if enabled at compile time.
+ *
+ * @param first The position of the first child.
+ * @param last The position after the last child.
+ * @return The position of the minimum child.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+std::size_t BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::minChild(std::size_t first, std::size_t last) const {
+  return ChildSelect<Arity, Storage::keyStride, Key, Compare>::min(heap, this->compare(), first, last);
 }
 
 /**
  * Function for emplacing a new item. O(log(n)).
  *
+ * The value is constructed in place from the arguments (a value of T is
+ * copied or moved, as usual).
+ *
  * @param priority The priority of the new item.
- * @param item The value of the new item.
- * @return A read-only pointer, for monitoring the item created.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full.
  */
-template <class T>
-const PriorityItem<T>* BinHeapPQ<T>::emplace(py_t priority, T item) {
-  if (size >= maxSize)
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::emplace(const Key& priority, Args&&... args) {
+  typename Stats::Stamp start = Stats::start();
+  if (size >= maxSize && !grow()) {
+    Stats::rejected();
     return nullptr; // if the queue if full, exit
-  PriorityItem<T>* newPriorityItem = new PriorityItem<T>{priority, item, size};
-  heap[size] = newPriorityItem; // temporary position
+  }
+  // heap[size] already refers to a free slot of the pool, construct in it
+  PriorityItem<T, Pos, Key>* newPriorityItem = heap.construct(size, priority, std::forward<Args>(args)...);
   size++;
   upRestore(size-1);
-  return newPriorityItem; // return control pointer
+  Stats::resized(size);
+  Stats::stop(PQStats::EMPLACE, start);
+  return Handle(newPriorityItem, heap.generation(newPriorityItem)); // return control handle
+}
+
+/**
+ * Function for replacing the minimum item with a new one. O(log(n)).
+ *
+ * The same as deleteMin and emplace, but the new item is put in the slot
+ * of the minimum and restored once, top-down; the handle of the old
+ * minimum becomes stale. If the queue is empty, it will raise an exception.
+ * The value is constructed before the minimum is destroyed (then moved in
+ * the slot), so the arguments can refer to the minimum and the queue is
+ * unchanged if the constructor throws.
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::replaceMin(const Key& priority, Args&&... args) {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  typename Stats::Stamp start = Stats::start();
+  T value(std::forward<Args>(args)...); // it may throw, or read the minimum
+  heap.destroy(0); // the slot stays in heap[0] as free
+  PriorityItem<T, Pos, Key>* newPriorityItem = heap.construct(0, priority, std::move(value));
+  downRestore(0);
+  Stats::stop(PQStats::DELETE_MIN, start);
+  return Handle(newPriorityItem, heap.generation(newPriorityItem));
+}
+
+/**
+ * Function for emplacing a new item and deleting the minimum, moving its value out. O(log(n)).
+ *
+ * The same as emplace and popMin, with one restore at most: if the new
+ * item would be the minimum (or the queue is empty) it's returned at
+ * once and the heap isn't touched, otherwise it replaces the minimum
+ * (see replaceMin). It works also if the queue is full; if the
+ * constructor of the value throws, the queue is unchanged.
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return The value associated to the minimum priority, the new one or the old one.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+T BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::pushPop(const Key& priority, Args&&... args) {
+  if (size == 0 || !less(heap.priority(0), priority))
+    return T(std::forward<Args>(args)...); // the new item is the minimum
+  T item(std::forward<Args>(args)...); // it may throw, with the queue unchanged
+  T value(std::move(heap.item(0)->item));
+  replaceMin(priority, std::move(item));
+  return value;
+}
+
+/**
+ * Check if the item of a handle is still in the queue. O(1).
+ *
+ * The handle must come from this queue (or be null).
+ *
+ * @param pi The handle of the item.
+ * @return False if the handle is null or the item was deleted.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::contains(Handle pi) {
+  return pi && heap.generation(pi.get()) == pi.generation();
 }
 
 /**
  * Function for decrease the priority of an item in the queue. O(log(n)).
  *
  * @param newPriority The new priority value of the item.
- * @param pi The read-only pointer of the item you want to modify.
+ * @param pi The handle of the item you want to modify; ignored if stale.
  */
-template <class T>
-void BinHeapPQ<T>::decrease(py_t newPriority, const PriorityItem<T>* pi) {
-  if (newPriority >= pi->priority)
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::decrease(const Key& newPriority, Handle pi) {
+  if (!contains(pi) || !less(newPriority, pi->priority))
     return; // if the newPriority isn't lesser then the current priority, nothing to do
-  heap[pi->pos]->priority = newPriority;
-  upRestore(pi->pos);
+  typename Stats::Stamp start = Stats::start();
+  Pos i = heap.position(pi.get());
+  heap.setPriority(i, newPriority);
+  upRestore(i);
+  Stats::stop(PQStats::DECREASE, start);
 }
 
 /**
  * Function for increase the priority of an item in the queue. O(log(n)).
  *
  * @param newPriority The new priority value of the item.
- * @param pi The read-only pointer of the item you want to modify.
+ * @param pi The handle of the item you want to modify; ignored if stale.
  */
-template <class T>
-void BinHeapPQ<T>::increase(py_t newPriority, const PriorityItem<T>* pi) {
-  if (newPriority <= pi->priority)
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::increase(const Key& newPriority, Handle pi) {
+  if (!contains(pi) || !less(pi->priority, newPriority))
     return; // if the newPriority isn't greater then the current priority, nothing to do
-  heap[pi->pos]->priority = newPriority;
-  downRestore(pi->pos);
+  typename Stats::Stamp start = Stats::start();
+  Pos i = heap.position(pi.get());
+  heap.setPriority(i, newPriority);
+  downRestore(i);
+  Stats::stop(PQStats::INCREASE, start);
+}
+
+/**
+ * Function for delete an item, anywhere in the queue. O(log(n)).
+ *
+ * The last item takes its position, and it's restored up or down.
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::erase(Handle pi) {
+  if (!contains(pi))
+    return false; // already deleted
+  typename Stats::Stamp start = Stats::start();
+  Pos i = heap.position(pi.get());
+  if (i != size-1) {
+    heap.swap(i, size-1);
+    Stats::swap();
+  }
+  heap.destroy(size-1); // the slot stays in heap[size] as free
+  size--;
+  
+  if (i < size) {
+    if (i > 0 && less(heap.priority(i), heap.priority(parent(i))))
+      upRestore(i);
+    else
+      downRestore(i);
+  }
+  Stats::stop(PQStats::ERASE, start);
+  return true;
 }
 
 /**
  * Function for delete the minimum priority item (and update the queue). O(log(n)).
  */
-template <class T>
-void BinHeapPQ<T>::deleteMin() {
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::deleteMin() {
   if (size <= 0)
     return; // nothing to delete
   
-  if (size > 1)
-    swap(heap[0], heap[size-1]);
-  delete heap[size-1]; // de-allocate
+  typename Stats::Stamp start = Stats::start();
+  if (size > 1) {
+    heap.swap(0, size-1);
+    Stats::swap();
+  }
+  heap.destroy(size-1); // the slot stays in heap[size] as free
   size--;
   
   if (size > 1)
     downRestore(0); // restore the heap
+  Stats::stop(PQStats::DELETE_MIN, start);
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+T BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::popMin() {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  T value(std::move(heap.item(0)->item));
+  deleteMin();
+  return value;
 }
+
+/**
+ * Function for delete all the items in the queue. O(n).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::clear() {
+  for (Pos i=0; i < size; i++)
+    heap.destroy(i); // the slots stay in the heap array as free
+  size = 0;
+}
+
+/**
+ * Floyd's bottom-up construction of the heap. O(n).
+ *
+ * Restores every internal node, from the last one to the root: the sub-heaps
+ * of its children are already legal heaps when a node is restored.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::heapify() {
+  if (size < 2)
+    return; // nothing to do
+  for (std::size_t i = Shape::lastParent(size) + 1; i-- > 0; )
+    if (firstChild(i) < size)
+      downRestore(i);
+}
+
+/**
+ * Function for replacing the content of the queue with a range of items. O(n).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<py_t, T>.
+ * @param last The end of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class InputIt>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::assign(InputIt first, InputIt last) {
+  clear();
+  for (; first != last && (size < maxSize || grow()); ++first, size++)
+    heap.construct(size, first->first, first->second);
+  heapify();
+  Stats::resized(size);
+  return size;
+}
+
+/**
+ * Function for replacing the content of the queue with a range of items,
+ * without losing the control handles. O(n).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<py_t, T>.
+ * @param last The end of the range.
+ * @param handles Where the handles are written, in the order of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class InputIt, class OutputIt>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::assign(InputIt first, InputIt last, OutputIt handles) {
+  clear();
+  for (; first != last && (size < maxSize || grow()); ++first, size++) {
+    PriorityItem<T, Pos, Key>* pi = heap.construct(size, first->first, first->second);
+    *handles++ = Handle(pi, heap.generation(pi));
+  }
+  heapify();
+  Stats::resized(size);
+  return size;
+}
+
+/**
+ * Restore of the heap after a batch of items was appended in [first, size). O(m + log(n)^2).
+ *
+ * Like heapify, but only the ancestors of the new items are restored,
+ * level by level (bottom-up): at every level they are a contiguous range.
+ *
+ * @param first The position of the first item appended.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::mergeRestore(std::size_t first) {
+  if (first >= size || size < 2)
+    return; // nothing to do
+  std::size_t lo = first, hi = size-1;
+  do {
+    lo = (lo > 0) ? parent(lo) : 0;
+    hi = parent(hi);
+    for (std::size_t i = hi+1; i-- > lo; )
+      downRestore(i);
+  } while (lo > 0);
+}
+
+/**
+ * Restore of the heap after a batch of items was appended in [start, size). O(m*log(n)) or O(m + log(n)^2).
+ *
+ * If the batch is small (not longer than the height of the heap) each
+ * item is restored bottom-up as emplace does, otherwise the ancestors of
+ * the batch are restored together (mergeRestore, or heapify with
+ * BlockLayout, if it's cheaper).
+ *
+ * @param start The position of the first item appended.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::batchRestore(Pos start) {
+  std::size_t height = 0;
+  for (std::size_t n = size; n > 1; n = parent(n-1) + 1)
+    height++;
+  std::size_t count = size - start;
+  if (count > height && Shape::levelOrder)
+    mergeRestore(start);
+  else if (count * height > size && !Shape::levelOrder)
+    heapify(); // the ancestors of the batch aren't contiguous ranges
+  else
+    for (std::size_t i = start; i < size; i++)
+      upRestore(i);
+  Stats::resized(size);
+}
+
+/**
+ * Function for emplacing a batch of new items. O(m*log(n)) or O(m + log(n)^2).
+ *
+ * The items are appended and restored together (see batchRestore).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<py_t, T>.
+ * @param last The end of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class InputIt>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::emplaceBatch(InputIt first, InputIt last) {
+  Pos start = size;
+  for (; first != last && (size < maxSize || grow()); ++first, size++)
+    heap.construct(size, first->first, first->second);
+  batchRestore(start);
+  return size - start;
+}
+
+/**
+ * Function for moving all the items of another queue in this one. O(n+m).
+ *
+ * The values are moved (not copied) in the slots of this queue, which
+ * grows if needed (also if it isn't growable), then the batch is restored
+ * together; the handles of the other queue become stale.
+ * The pool of the other queue isn't adopted (as PairingHeapPQ does): the
+ * heap arrays index the slots of their own pool, and the batch must be
+ * restored anyway, so the merge is linear in (m) and never sub-linear.
+ *
+ * @param other The queue emptied.
+ * @return The number of items moved; less than the size of the other
+ * queue only if this one can't store them all (the maximum of Pos).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::merge(BinHeapPQ&& other) {
+  return merge(std::move(other), DiscardOutput());
+}
+
+/**
+ * Function for moving all the items of another queue in this one,
+ * without losing the control handles. O(n+m).
+ *
+ * The items are taken from the end of the other heap, so if they don't
+ * fit all, the items left in the other queue are still a legal heap.
+ *
+ * @param other The queue emptied.
+ * @param handles Where the pairs (old handle, new handle) of the items moved are written.
+ * @return The number of items moved; less than the size of the other
+ * queue only if this one can't store them all (the maximum of Pos).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class OutputIt>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::merge(BinHeapPQ&& other, OutputIt handles) {
+  if (&other == this)
+    return 0; // nothing to do
+  Pos count = other.size;
+  if (count > std::numeric_limits<Pos>::max() - size)
+    count = std::numeric_limits<Pos>::max() - size;
+  reserve(size + count);
+  
+  Pos start = size;
+  for (Pos j=0; j < count; j++, size++) {
+    PriorityItem<T, Pos, Key>* from = other.heap.item(other.size-1);
+    PriorityItem<T, Pos, Key>* to = heap.construct(size, from->priority, std::move(from->item));
+    *handles++ = std::make_pair(Handle(from, other.heap.generation(from)), Handle(to, heap.generation(to)));
+    other.heap.destroy(other.size-1);
+    other.size--;
+  }
+  batchRestore(start);
+  return count;
+}
+
+/**
+ * Function for delete the (k) minimum priority items, moving their values out. O(k*log(n)).
+ *
+ * The (k) minimum items are found with a best-first visit of the heap
+ * (they are a sub-tree containing the root), then their positions are filled
+ * with the last items and restored together, from the deepest one.
+ *
+ * @param k The number of items to delete.
+ * @param out Where the values are moved, in order of priority.
+ * @return The number of items deleted, less than (k) if the queue has less items.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class OutputIt>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::popMin(Pos k, OutputIt out) {
+  if (k > size)
+    k = size;
+  if (k == 0)
+    return 0; // nothing to delete
+  
+  typedef std::pair<Key, std::size_t> Candidate; // (priority, position)
+  struct Later { // order of the candidates, the first on top
+    const BinHeapPQ* queue;
+    bool operator()(const Candidate& a, const Candidate& b) const { return queue->less(b.first, a.first); }
+  };
+  std::vector<Candidate> frontier;
+  frontier.reserve(std::size_t(k) * (Arity-1) + 1);
+  std::priority_queue<Candidate, std::vector<Candidate>, Later>
+    candidates(Later{this}, std::move(frontier));
+  std::vector<std::size_t> selected;
+  selected.reserve(k);
+  
+  candidates.push(Candidate(heap.priority(0), 0));
+  while (selected.size() < k) {
+    std::size_t i = candidates.top().second;
+    candidates.pop();
+    selected.push_back(i);
+    *out++ = std::move(heap.item(i)->item);
+    for (std::size_t c = firstChild(i); c < firstChild(i) + Arity && c < size; c++)
+      candidates.push(Candidate(heap.priority(c), c));
+  }
+  
+  // delete from the deepest: the last item never is one still to delete
+  std::sort(selected.begin(), selected.end(), std::greater<std::size_t>());
+  for (std::size_t j = 0; j < selected.size(); j++) {
+    if (selected[j] != std::size_t(size-1)) {
+      heap.swap(selected[j], size-1);
+      Stats::swap();
+    }
+    heap.destroy(size-1);
+    size--;
+  }
+  for (std::size_t j = 0; j < selected.size(); j++)
+    if (selected[j] < size)
+      downRestore(selected[j]);
+  return k;
+}
+
+/**
+ * Function for updating or deleting all the items at once. O(n).
+ *
+ * The function (update) is called once for every item, in no order, with
+ * its priority and its value: it can change both, and it returns false
+ * to delete the item. Then the heap is built again (heapify), so the
+ * cost doesn't depend on how many items were changed.
+ *
+ * @param update The function bool(Key& priority, T& value).
+ * @return The number of items deleted.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class Update>
+Pos BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::rebuild(Update update) {
+  Pos deleted = 0;
+  for (Pos i=0; i < size; ) {
+    Key priority = heap.priority(i);
+    if (update(priority, heap.item(i)->item)) {
+      heap.setPriority(i, priority);
+      i++;
+    } else { // the last item takes its place, and it's checked next
+      if (i != size-1)
+        heap.swap(i, size-1);
+      heap.destroy(size-1);
+      size--;
+      deleted++;
+    }
+  }
+  heapify();
+  return deleted;
+}
+
+/**
+ * Function for get the statistics collected by the Stats policy. O(1).
+ *
+ * @return A snapshot of the counters (all zero with NoStats).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+PQStats BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::stats() const {
+  return Stats::snapshot();
+}
+
+/**
+ * Function for reset the statistics collected by the Stats policy. O(1).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::resetStats() {
+  Stats::reset();
+}
+
+#endif
@@ -0,0 +1,268 @@
+/**
+ * @file BlockingPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Blocking pops on a ConcurrentPQ: the consumers sleep (a thread on a
+ * condition variable, or a C++20 coroutine) until an item is there.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef BLOCKINGPQ_CPP
+#define BLOCKINGPQ_CPP
+
+#include "ConcurrentPQ.cpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <deque>
+#define BLOCKINGPQ_COROUTINES
+#endif
+#endif
+
+/**
+ * Thread-safe priority queue whose consumers can wait for an item.
+ *
+ * A ConcurrentPQ (with the same Ordering and Queue) holds the items; the
+ * waiters are counted in an atomic, so a producer takes the mutex and
+ * wakes somebody only if there is a consumer waiting: without waiters
+ * emplace costs as in ConcurrentPQ. The waiter announces itself and tries
+ * again before sleeping, and the producer checks the count after the
+ * emplace (a Dekker-like handshake, with seq_cst fences): an item is
+ * never left in the queue with a consumer asleep.
+ * waitPop(out, n, timeout) sleeps once and takes up to (n) items, so one
+ * wake-up can deliver a whole batch; emplaceBatch wakes once for all.
+ * With C++20, co_await pop() suspends the coroutine instead of a thread:
+ * the producer resumes it, on its own thread, with the item already popped
+ * (a direct handoff); the queue must outlive the suspended coroutines.
+ */
+template <class T, class Ordering = StrictOrder, class Queue = BinHeapPQ<T> >
+class BlockingPQ {
+public:
+  typedef typename ConcurrentPQ<T, Ordering, Queue>::Size Size;	/**< Type of sizes of the queue.   */
+  typedef typename ConcurrentPQ<T, Ordering, Queue>::Priority Priority;	/**< Type of the priorities. */
+  typedef typename ConcurrentPQ<T, Ordering, Queue>::Handle Handle;	/**< Read-only pointer to an item. */
+#ifdef BLOCKINGPQ_COROUTINES
+  class PopAwaiter;
+#endif
+private:
+  ConcurrentPQ<T, Ordering, Queue> queue;	/**< The items.                             */
+  std::atomic<unsigned> waiters;	/**< Consumers waiting, or about to wait.   */
+  std::mutex mutex;			/**< Protects epoch and suspended.          */
+  std::condition_variable ready;	/**< Where the threads sleep.               */
+  std::uint64_t epoch;			/**< Number of wake-ups.                    */
+#ifdef BLOCKINGPQ_COROUTINES
+  std::deque<PopAwaiter*> suspended;	/**< Coroutines waiting, the oldest first.  */
+#endif
+  void wake(std::size_t);
+  template <class Rep, class Period>
+  bool sleep(T&, const std::chrono::duration<Rep, Period>&);
+public:
+  BlockingPQ(Size, unsigned = 64);
+  BlockingPQ(const BlockingPQ&) = delete;
+  BlockingPQ& operator=(const BlockingPQ&) = delete;
+  template <class... Args>
+  Handle emplace(const Priority&, Args&&...);
+  template <class InputIt>
+  std::size_t emplaceBatch(InputIt, InputIt);
+  bool tryPopMin(T& out) { return queue.tryPopMin(out); }
+  template <class Rep, class Period>
+  bool waitPop(T&, const std::chrono::duration<Rep, Period>&);
+  template <class OutputIt, class Rep, class Period>
+  std::size_t waitPop(OutputIt, std::size_t, const std::chrono::duration<Rep, Period>&);
+  bool isEmpty() { return queue.isEmpty(); }
+#ifdef BLOCKINGPQ_COROUTINES
+  PopAwaiter pop() { return PopAwaiter(*this); }
+#endif
+};
+
+#ifdef BLOCKINGPQ_COROUTINES
+/**
+ * What co_await pop() waits: it doesn't suspend if an item is there,
+ * otherwise the coroutine is queued and resumed by a producer.
+ * T must be default constructible, as for tryPopMin.
+ */
+template <class T, class Ordering, class Queue>
+class BlockingPQ<T, Ordering, Queue>::PopAwaiter {
+private:
+  friend class BlockingPQ;
+  BlockingPQ& pq;			/**< The queue.                      */
+  T value;				/**< The item popped.                */
+  std::coroutine_handle<> coroutine;	/**< The coroutine, while suspended. */
+public:
+  PopAwaiter(BlockingPQ& pq) : pq(pq) {}
+  bool await_ready() { return pq.queue.tryPopMin(value); }
+  bool await_suspend(std::coroutine_handle<> h) {
+    coroutine = h;
+    std::lock_guard<std::mutex> lock(pq.mutex);
+    pq.waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (pq.queue.tryPopMin(value)) { // an emplace was late for the waiter count
+      pq.waiters.fetch_sub(1);
+      return false;
+    }
+    pq.suspended.push_back(this);
+    return true;
+  }
+  T await_resume() { return std::move(value); }
+};
+#endif
+
+/**
+ * Init the queue. O(n).
+ *
+ * @param maxSize The maximum size, as for ConcurrentPQ.
+ * @param n The number of threads with a record (StrictOrder) or of queues (RelaxedOrder).
+ */
+template <class T, class Ordering, class Queue>
+BlockingPQ<T, Ordering, Queue>::BlockingPQ(Size maxSize, unsigned n)
+  : queue(maxSize, n), waiters(0), epoch(0) {
+}
+
+/**
+ * Wake up to (n) consumers, after (n) items were emplaced. O(1) without waiters.
+ *
+ * The suspended coroutines come first: their items are popped here and
+ * they are resumed by this thread, after the mutex is released.
+ *
+ * @param n The number of items emplaced.
+ */
+template <class T, class Ordering, class Queue>
+void BlockingPQ<T, Ordering, Queue>::wake(std::size_t n) {
+  std::atomic_thread_fence(std::memory_order_seq_cst); // the emplace is before the load
+  if (n == 0 || waiters.load(std::memory_order_relaxed) == 0)
+    return; // nobody to wake, no system call
+  std::unique_lock<std::mutex> lock(mutex);
+#ifdef BLOCKINGPQ_COROUTINES
+  std::vector<std::coroutine_handle<> > resumed;
+  while (n > 0 && !suspended.empty() && queue.tryPopMin(suspended.front()->value)) {
+    resumed.push_back(suspended.front()->coroutine);
+    suspended.pop_front();
+    waiters.fetch_sub(1);
+    n--;
+  }
+#endif
+  if (n > 0) {
+    epoch++;
+    if (n == 1)
+      ready.notify_one();
+    else
+      ready.notify_all();
+  }
+  lock.unlock();
+#ifdef BLOCKINGPQ_COROUTINES
+  for (std::size_t i=0; i < resumed.size(); i++)
+    resumed[i].resume();
+#endif
+}
+
+/**
+ * Sleep until an item is popped or the timeout expires.
+ *
+ * @param out Where the value is moved.
+ * @param timeout The maximum time to wait.
+ * @return False if the timeout expired with the queue empty.
+ */
+template <class T, class Ordering, class Queue>
+template <class Rep, class Period>
+bool BlockingPQ<T, Ordering, Queue>::sleep(T& out, const std::chrono::duration<Rep, Period>& timeout) {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+  std::unique_lock<std::mutex> lock(mutex);
+  waiters.fetch_add(1);
+  bool found = false;
+  while (!found) {
+    std::uint64_t seen = epoch;
+    lock.unlock();
+    std::atomic_thread_fence(std::memory_order_seq_cst); // the count is before the pop
+    found = queue.tryPopMin(out);
+    lock.lock();
+    if (!found && !ready.wait_until(lock, deadline, [&]() { return epoch != seen; }))
+      break; // timeout
+  }
+  waiters.fetch_sub(1);
+  lock.unlock();
+  return found || queue.tryPopMin(out);
+}
+
+/**
+ * Function for emplacing a new item, waking a consumer if one is waiting. O(log(n)).
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A read-only pointer to the item created, nullptr if the queue is full.
+ */
+template <class T, class Ordering, class Queue>
+template <class... Args>
+typename BlockingPQ<T, Ordering, Queue>::Handle
+BlockingPQ<T, Ordering, Queue>::emplace(const Priority& priority, Args&&... args) {
+  Handle h = queue.emplace(priority, std::forward<Args>(args)...);
+  if (h)
+    wake(1);
+  return h;
+}
+
+/**
+ * Function for emplacing a range of items, with a single wake-up. O(m*log(n)).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<Priority, T>.
+ * @param last The end of the range.
+ * @return The number of items emplaced; it stops at the first one refused (full queue).
+ */
+template <class T, class Ordering, class Queue>
+template <class InputIt>
+std::size_t BlockingPQ<T, Ordering, Queue>::emplaceBatch(InputIt first, InputIt last) {
+  std::size_t n = 0;
+  for (; first != last && queue.emplace(first->first, first->second); ++first)
+    n++;
+  wake(n);
+  return n;
+}
+
+/**
+ * Function for delete the minimum priority item, waiting for one if the queue is empty.
+ *
+ * @param out Where the value is moved.
+ * @param timeout The maximum time to wait.
+ * @return False if the timeout expired with the queue empty.
+ */
+template <class T, class Ordering, class Queue>
+template <class Rep, class Period>
+bool BlockingPQ<T, Ordering, Queue>::waitPop(T& out, const std::chrono::duration<Rep, Period>& timeout) {
+  return queue.tryPopMin(out) || sleep(out, timeout);
+}
+
+/**
+ * Function for delete up to (n) items, waiting only for the first one.
+ *
+ * @param out Where the values are moved, in order of priority (as tryPopMin).
+ * @param n The maximum number of items.
+ * @param timeout The maximum time to wait for the first item.
+ * @return The number of items deleted, zero if the timeout expired.
+ */
+template <class T, class Ordering, class Queue>
+template <class OutputIt, class Rep, class Period>
+std::size_t BlockingPQ<T, Ordering, Queue>::waitPop(OutputIt out, std::size_t n, const std::chrono::duration<Rep, Period>& timeout) {
+  if (n == 0)
+    return 0;
+  T value;
+  if (!waitPop(value, timeout))
+    return 0;
+  *out++ = std::move(value);
+  std::size_t count = 1;
+  for (; count < n && queue.tryPopMin(value); count++)
+    *out++ = std::move(value);
+  return count;
+}
+
+#endif
@@ -0,0 +1,584 @@
+/**
+ * @file ConcurrentPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Thread-safe priority queue, with strict or relaxed ordering, built on BinHeapPQ.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef CONCURRENTPQ_CPP
+#define CONCURRENTPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * Size of a cache line: the data written by different threads is aligned
+ * to it, to avoid false sharing.
+ */
+static const std::size_t cacheLine = 64;
+
+/**
+ * Waiting strategy of a spinning thread: a pause hint to the processor for
+ * the first iterations, then it yields (the owner could be not running).
+ */
+class Backoff {
+private:
+  unsigned spins;
+public:
+  Backoff() : spins(0) {}
+  void pause() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (++spins < 64) {
+      __builtin_ia32_pause();
+      return;
+    }
+#endif
+    std::this_thread::yield();
+  }
+};
+
+/**
+ * A small test-and-test-and-set lock, for very short critical sections.
+ */
+class SpinLock {
+private:
+  std::atomic<bool> locked;
+public:
+  SpinLock() : locked(false) {}
+  SpinLock(const SpinLock&) = delete;
+  SpinLock& operator=(const SpinLock&) = delete;
+  bool tryLock() { return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire); }
+  void lock() { for (Backoff b; !tryLock(); ) b.pause(); }
+  void unlock() { locked.store(false, std::memory_order_release); }
+};
+
+/**
+ * The indexes of the threads alive: a thread which exits gives its index
+ * back, and a new thread takes the lowest one free.
+ */
+class ThreadIndexes {
+private:
+  SpinLock lock;
+  unsigned next;	/**< The lowest index never taken.   */
+  std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned> > free; /**< Indexes given back. */
+public:
+  ThreadIndexes() : next(0) {}
+  unsigned acquire() {
+    lock.lock();
+    unsigned index = next;
+    if (free.empty())
+      next++;
+    else {
+      index = free.top();
+      free.pop();
+    }
+    lock.unlock();
+    return index;
+  }
+  void release(unsigned index) {
+    lock.lock();
+    free.push(index);
+    lock.unlock();
+  }
+  static ThreadIndexes& instance() {
+    static ThreadIndexes* indexes = new ThreadIndexes; // never destroyed, the threads can exit after main
+    return *indexes;
+  }
+};
+
+/**
+ * The index of a thread, taken at its first call of threadIndex() and
+ * given back when the thread exits.
+ */
+struct ThreadIndex {
+  unsigned index;
+  ThreadIndex() : index(ThreadIndexes::instance().acquire()) {}
+  ~ThreadIndex() { ThreadIndexes::instance().release(index); }
+};
+
+/**
+ * A small number identifying the calling thread, unique among the threads
+ * alive: 0 for the first thread that calls it, 1 for the second one, and
+ * so on; the index of a thread which exited is reused, the lowest first.
+ */
+inline unsigned threadIndex() {
+  static thread_local ThreadIndex index;
+  return index.index;
+}
+
+/**
+ * Fast pseudo-random number (xorshift) from a generator private to the calling thread.
+ */
+inline unsigned threadRandom() {
+  static thread_local unsigned long long s = 0x9E3779B97F4A7C15ull * (threadIndex() + 1);
+  s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+  return (unsigned)(s >> 32);
+}
+
+/**
+ * Fixed array of objects aligned to the cache line, each one padded to a
+ * whole number of lines (the type X must be declared alignas(cacheLine)).
+ */
+template <class X>
+class AlignedArray {
+private:
+  void* raw;		/**< Memory allocated.          */
+  X* data;		/**< First (aligned) object.    */
+  std::size_t n;	/**< Number of objects.         */
+public:
+  template <class... Args>
+  AlignedArray(std::size_t n, Args&&... args) : n(n) {
+    raw = ::operator new(sizeof(X) * n + cacheLine);
+    data = reinterpret_cast<X*>((reinterpret_cast<std::size_t>(raw) + cacheLine - 1) & ~(cacheLine - 1));
+    for (std::size_t i=0; i < n; i++)
+      new (data + i) X(args...);
+  }
+  ~AlignedArray() {
+    for (std::size_t i=0; i < n; i++)
+      data[i].~X();
+    ::operator delete(raw);
+  }
+  AlignedArray(const AlignedArray&) = delete;
+  AlignedArray& operator=(const AlignedArray&) = delete;
+  X& operator[](std::size_t i) { return data[i]; }
+  std::size_t size() const { return n; }
+};
+
+/**
+ * Ordering policy: deleteMin always removes the minimum item (linearizable).
+ */
+struct StrictOrder {};
+/**
+ * Ordering policy: deleteMin removes an item close to the minimum, for throughput.
+ */
+struct RelaxedOrder {};
+
+/**
+ * Thread-safe priority queue; all the members can be called concurrently.
+ *
+ * The Ordering policy (StrictOrder or RelaxedOrder) chooses the algorithm,
+ * Queue is the (not thread-safe) queue used inside, a BinHeapPQ by default;
+ * its Priority type and its Comparator are the ones of the wrapper.
+ * As in BinHeapPQ, emplace returns a read-only pointer to the item.
+ * Since min() and deleteMin() can't be two separated calls here, they are
+ * joined in tryPopMin().
+ */
+template <class T, class Ordering = StrictOrder, class Queue = BinHeapPQ<T> >
+class ConcurrentPQ;
+
+/**
+ * Strict ordering, with flat combining on a single queue.
+ *
+ * Every thread publishes its request in its own record and spins on it;
+ * the thread that gets the lock becomes the "combiner" and executes all the
+ * requests published, so the queue and the lock stay in the cache of one
+ * core, and the pops are served together by a single popMin(k).
+ * The threads with an index below maxThreads (threadIndex, reused when a
+ * thread exits) have a record; the others take the lock and execute their
+ * request directly.
+ *
+ * |------------------------------|---------------------------|
+ * | Emplace new item 	O(log(n)) | Mem        		O(n)  |
+ * | De/In-crease key 	O(log(n)) |---------------------------|
+ * | Pop min 		O(log(n)) |
+ * |------------------------------|
+ */
+template <class T, class Queue>
+class ConcurrentPQ<T, StrictOrder, Queue> {
+public:
+  typedef typename Queue::Size Size;	/**< Type of sizes of the queue.   */
+  typedef typename Queue::Priority Priority;	/**< Type of the priorities.     */
+  typedef typename Queue::Handle Handle;	/**< Read-only pointer to an item. */
+private:
+  enum State { IDLE, PENDING, DONE };
+  enum Op { EMPLACE, POP, DECREASE, INCREASE };
+  struct alignas(cacheLine) Record {
+    std::atomic<int> state; /**< State of the request (State).            */
+    Op op;                  /**< Operation requested.                     */
+    Priority priority;      /**< Priority (emplace, de/in-crease).        */
+    T* value;               /**< Value moved in (emplace) or out (pop).   */
+    Handle handle;          /**< Item created (emplace) or to modify.     */
+    bool done;              /**< If the pop found an item.                */
+    Record() : state(IDLE) {}
+  };
+  /**
+   * Output iterator for popMin(k): every value goes into the next pop request.
+   */
+  struct PopOutput {
+    Record** r;
+    PopOutput& operator*() { return *this; }
+    PopOutput& operator++() { ++r; return *this; }
+    PopOutput operator++(int) { PopOutput old = *this; ++r; return old; }
+    PopOutput& operator=(T&& v) { *(*r)->value = std::move(v); (*r)->done = true; return *this; }
+  };
+  struct alignas(cacheLine) Shared {
+    SpinLock lock;		/**< Held by the combiner.                     */
+    Queue queue;		/**< The queue, accessed only by the combiner. */
+    std::vector<Record*> pops;	/**< Pop requests of a combining pass.         */
+    Shared(Size maxSize) : queue(maxSize) {}
+  };
+  AlignedArray<Shared> shared;	/**< The queue and its lock (one object). */
+  AlignedArray<Record> records;	/**< One record for every thread.         */
+  void execute(Record&);
+  void combine();
+  void submit(Record&, bool);
+public:
+  ConcurrentPQ(Size, unsigned = 64);
+  template <class... Args>
+  Handle emplace(const Priority&, Args&&...);
+  void decrease(const Priority&, Handle);
+  void increase(const Priority&, Handle);
+  bool tryPopMin(T&);
+  bool isEmpty();
+};
+
+/**
+ * Relaxed ordering, with many queues (a "MultiQueue").
+ *
+ * Every queue has its own spin lock and is aligned to the cache line.
+ * An emplace goes into a random queue; a pop looks at the minimum of two
+ * random queues and deletes the best one (by the Comparator of Queue).
+ * With (c*threads) queues the item deleted is, on average, among the first
+ * O(c*threads) ones. The minimum of every queue is published in an atomic,
+ * with a flag for the empty queue, so the priorities must be trivially
+ * copyable.
+ * The handles are valid, but decrease and increase are not available:
+ * the queue of an item isn't known.
+ *
+ * |------------------------------|---------------------------|
+ * | Emplace new item 	O(log(n)) | Mem        		O(n)  |
+ * | Pop (almost) min 	O(log(n)) |---------------------------|
+ * |------------------------------|
+ */
+template <class T, class Queue>
+class ConcurrentPQ<T, RelaxedOrder, Queue> {
+public:
+  typedef typename Queue::Size Size;	/**< Type of sizes of the queue.   */
+  typedef typename Queue::Priority Priority;	/**< Type of the priorities.     */
+  typedef typename Queue::Handle Handle;	/**< Read-only pointer to an item. */
+private:
+  struct alignas(cacheLine) SubQueue {
+    SpinLock lock;		/**< Protects the queue.                       */
+    std::atomic<bool> empty;	/**< If the queue is empty (hint).             */
+    std::atomic<Priority> top;	/**< Minimum priority, if not empty (hint).    */
+    Queue queue;		/**< The queue.                                */
+    SubQueue(Size maxSize) : empty(true), top(Priority()), queue(maxSize) {}
+    void update() {
+      if (!queue.isEmpty())
+        top.store(queue.minPriority(), std::memory_order_relaxed);
+      empty.store(queue.isEmpty(), std::memory_order_relaxed);
+    }
+  };
+  AlignedArray<SubQueue> queues; /**< The queues. */
+  bool less(const Priority& a, const Priority& b) { return queues[0].queue.comparator()(a, b); }
+  SubQueue& better(SubQueue&, SubQueue&);
+public:
+  ConcurrentPQ(Size, unsigned);
+  template <class... Args>
+  Handle emplace(const Priority&, Args&&...);
+  bool tryPopMin(T&);
+  bool isEmpty();
+};
+
+/**
+ * Init the queue. O(n).
+ *
+ * @param maxSize The maximum size (number of items) you want to.
+ * @param maxThreads The number of threads with a record (the others are slower).
+ */
+template <class T, class Queue>
+ConcurrentPQ<T, StrictOrder, Queue>::ConcurrentPQ(Size maxSize, unsigned maxThreads)
+  : shared(1, maxSize), records(maxThreads) {
+  shared[0].pops.reserve(maxThreads);
+}
+
+/**
+ * Execute a single request, with the lock held.
+ *
+ * @param r The request.
+ */
+template <class T, class Queue>
+void ConcurrentPQ<T, StrictOrder, Queue>::execute(Record& r) {
+  Queue& queue = shared[0].queue;
+  switch (r.op) {
+    case EMPLACE: r.handle = queue.emplace(r.priority, std::move(*r.value)); break;
+    case DECREASE: queue.decrease(r.priority, r.handle); break;
+    case INCREASE: queue.increase(r.priority, r.handle); break;
+    case POP:
+      r.done = !queue.isEmpty();
+      if (r.done)
+        *r.value = queue.popMin();
+      break;
+  }
+}
+
+/**
+ * Combining pass: execute all the requests published, with the lock held.
+ *
+ * The pops are executed after the other requests, all together.
+ */
+template <class T, class Queue>
+void ConcurrentPQ<T, StrictOrder, Queue>::combine() {
+  std::vector<Record*>& pops = shared[0].pops;
+  pops.clear();
+  for (std::size_t i=0; i < records.size(); i++) {
+    Record& r = records[i];
+    if (r.state.load(std::memory_order_acquire) != PENDING)
+      continue;
+    if (r.op == POP) {
+      r.done = false;
+      pops.push_back(&r);
+    } else {
+      execute(r);
+      r.state.store(DONE, std::memory_order_release);
+    }
+  }
+  if (pops.empty())
+    return;
+  PopOutput out = { pops.data() };
+  shared[0].queue.popMin(pops.size(), out);
+  for (std::size_t j=0; j < pops.size(); j++)
+    pops[j]->state.store(DONE, std::memory_order_release);
+}
+
+/**
+ * Publish a request and wait until it's done, combining if the lock is free.
+ *
+ * @param r The request.
+ * @param published If (r) is the record of this thread, or a local one.
+ */
+template <class T, class Queue>
+void ConcurrentPQ<T, StrictOrder, Queue>::submit(Record& r, bool published) {
+  SpinLock& lock = shared[0].lock;
+  if (!published) { // the thread has no record, it can't wait for a combiner
+    lock.lock();
+    combine();
+    execute(r);
+    lock.unlock();
+    return;
+  }
+  r.state.store(PENDING, std::memory_order_release);
+  for (Backoff b; r.state.load(std::memory_order_acquire) != DONE; ) {
+    if (lock.tryLock()) {
+      combine(); // our request is pending, it's executed too
+      lock.unlock();
+    } else
+      b.pause();
+  }
+  r.state.store(IDLE, std::memory_order_relaxed);
+}
+
+/**
+ * Function for emplacing a new item. O(log(n)).
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A read-only pointer to the item created, nullptr if the queue is full.
+ */
+template <class T, class Queue>
+template <class... Args>
+typename ConcurrentPQ<T, StrictOrder, Queue>::Handle
+ConcurrentPQ<T, StrictOrder, Queue>::emplace(const Priority& priority, Args&&... args) {
+  T value(std::forward<Args>(args)...);
+  Record local;
+  Record& r = threadIndex() < records.size() ? records[threadIndex()] : local;
+  r.op = EMPLACE;
+  r.priority = priority;
+  r.value = &value;
+  submit(r, &r != &local);
+  return r.handle;
+}
+
+/**
+ * Function for decrease the priority of an item in the queue. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The read-only pointer of the item, it must be still in the queue.
+ */
+template <class T, class Queue>
+void ConcurrentPQ<T, StrictOrder, Queue>::decrease(const Priority& newPriority, Handle pi) {
+  Record local;
+  Record& r = threadIndex() < records.size() ? records[threadIndex()] : local;
+  r.op = DECREASE;
+  r.priority = newPriority;
+  r.handle = pi;
+  submit(r, &r != &local);
+}
+
+/**
+ * Function for increase the priority of an item in the queue. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The read-only pointer of the item, it must be still in the queue.
+ */
+template <class T, class Queue>
+void ConcurrentPQ<T, StrictOrder, Queue>::increase(const Priority& newPriority, Handle pi) {
+  Record local;
+  Record& r = threadIndex() < records.size() ? records[threadIndex()] : local;
+  r.op = INCREASE;
+  r.priority = newPriority;
+  r.handle = pi;
+  submit(r, &r != &local);
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(n)).
+ *
+ * @param out Where the value is moved.
+ * @return False if the queue was empty.
+ */
+template <class T, class Queue>
+bool ConcurrentPQ<T, StrictOrder, Queue>::tryPopMin(T& out) {
+  Record local;
+  Record& r = threadIndex() < records.size() ? records[threadIndex()] : local;
+  r.op = POP;
+  r.value = &out;
+  submit(r, &r != &local);
+  return r.done;
+}
+
+/**
+ * Check if the queue is empty; the answer may be old as soon as it's returned. O(1).
+ *
+ * @return True only if the current size is zero.
+ */
+template <class T, class Queue>
+bool ConcurrentPQ<T, StrictOrder, Queue>::isEmpty() {
+  shared[0].lock.lock();
+  bool empty = shared[0].queue.isEmpty();
+  shared[0].lock.unlock();
+  return empty;
+}
+
+/**
+ * Init the queues. O(n).
+ *
+ * @param maxSize The maximum size (number of items) of each queue.
+ * @param n The number of queues, for example 2-4 times the number of threads.
+ */
+template <class T, class Queue>
+ConcurrentPQ<T, RelaxedOrder, Queue>::ConcurrentPQ(Size maxSize, unsigned n)
+  : queues(n > 0 ? n : 1, maxSize) {
+}
+
+/**
+ * The queue with the better minimum, from the hints. O(1).
+ *
+ * @param a A queue.
+ * @param b Another queue.
+ * @return The queue not empty with the minimum first for the Comparator, (a) if both are empty.
+ */
+template <class T, class Queue>
+typename ConcurrentPQ<T, RelaxedOrder, Queue>::SubQueue&
+ConcurrentPQ<T, RelaxedOrder, Queue>::better(SubQueue& a, SubQueue& b) {
+  if (b.empty.load(std::memory_order_relaxed))
+    return a;
+  if (a.empty.load(std::memory_order_relaxed))
+    return b;
+  return less(b.top.load(std::memory_order_relaxed), a.top.load(std::memory_order_relaxed)) ? b : a;
+}
+
+/**
+ * Function for emplacing a new item in a random queue. O(log(n)).
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A read-only pointer to the item created, nullptr if all the queues are full.
+ */
+template <class T, class Queue>
+template <class... Args>
+typename ConcurrentPQ<T, RelaxedOrder, Queue>::Handle
+ConcurrentPQ<T, RelaxedOrder, Queue>::emplace(const Priority& priority, Args&&... args) {
+  std::size_t n = queues.size();
+  for (std::size_t attempt = 0; attempt < 2*n; attempt++) {
+    SubQueue& q = queues[threadRandom() % n];
+    if (!q.lock.tryLock())
+      continue; // busy, try another one
+    Handle h = q.queue.emplace(priority, std::forward<Args>(args)...); // the args are used only if it succeeds
+    if (h)
+      q.update();
+    q.lock.unlock();
+    if (h)
+      return h;
+  }
+  for (std::size_t i = 0; i < n; i++) { // all busy or full, look at all of them
+    SubQueue& q = queues[i];
+    q.lock.lock();
+    Handle h = q.queue.emplace(priority, std::forward<Args>(args)...);
+    if (h)
+      q.update();
+    q.lock.unlock();
+    if (h)
+      return h;
+  }
+  return nullptr;
+}
+
+/**
+ * Function for delete an item with (almost) the minimum priority, moving its value out. O(log(n)).
+ *
+ * @param out Where the value is moved.
+ * @return False if all the queues were empty.
+ */
+template <class T, class Queue>
+bool ConcurrentPQ<T, RelaxedOrder, Queue>::tryPopMin(T& out) {
+  std::size_t n = queues.size();
+  for (std::size_t attempt = 0; attempt < 2*n; attempt++) {
+    SubQueue& a = queues[threadRandom() % n];
+    SubQueue& b = queues[threadRandom() % n];
+    SubQueue& q = better(a, b);
+    if (q.empty.load(std::memory_order_relaxed) || !q.lock.tryLock())
+      continue; // (probably) empty or busy, try other ones
+    bool found = !q.queue.isEmpty();
+    if (found) {
+      out = q.queue.popMin();
+      q.update();
+    }
+    q.lock.unlock();
+    if (found)
+      return true;
+  }
+  for (std::size_t i = 0; i < n; i++) { // look at all of them before failing
+    SubQueue& q = queues[i];
+    q.lock.lock();
+    bool found = !q.queue.isEmpty();
+    if (found) {
+      out = q.queue.popMin();
+      q.update();
+    }
+    q.lock.unlock();
+    if (found)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Check if all the queues are empty; the answer may be old as soon as it's returned. O(queues).
+ *
+ * @return True only if the current size of all the queues is zero.
+ */
+template <class T, class Queue>
+bool ConcurrentPQ<T, RelaxedOrder, Queue>::isEmpty() {
+  for (std::size_t i = 0; i < queues.size(); i++) {
+    queues[i].lock.lock();
+    bool empty = queues[i].queue.isEmpty();
+    queues[i].lock.unlock();
+    if (!empty)
+      return false;
+  }
+  return true;
+}
+
+#endif
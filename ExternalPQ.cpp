@@ -0,0 +1,491 @@
+/**
+ * @file ExternalPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * External-memory priority queue, for more items than fit in memory:
+ * a BinHeapPQ in memory, which spills sorted runs to temporary files.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef EXTERNALPQ_CPP
+#define EXTERNALPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/types.h>
+#define EXTERNALPQ_POSIX
+#endif
+
+/**
+ * Priority queue of trivially copyable keys and values without a bound
+ * on the number of items (but the disk), in the style of a sequence heap.
+ *
+ * The items are in a BinHeapPQ of memoryItems at most, or in sorted runs
+ * in temporary files. When the heap is full it's sorted: the best half
+ * stays in memory (a sorted array is already a heap) and the worst half
+ * is written as a new run. The minimum is the best of the heap and of the
+ * heads of the runs, kept in a second (small) heap.
+ * Every run is read by blocks of blockItems, and the next block is read
+ * ahead while the current one is consumed: on POSIX systems the kernel is
+ * asked for it (posix_fadvise, no thread at all), elsewhere it's read by
+ * another thread (std::async, compile with -pthread). The pops wait for
+ * the disk only if they are faster.
+ * The runs have levels, as in a sequence heap: a spill writes a run of
+ * level 0, and when there are maxRuns runs of a level they are merged into
+ * one run of the next level, so every item is written O(log_R(N/M)) times.
+ * A merge stops at the first failed write: the runs not read yet, the
+ * part already written and the records taken in between (kept in memory,
+ * as a run without a file) stay in the queue.
+ * There are no handles (an item on the disk can't be changed).
+ *
+ * |------------------------------|---------------------------------|
+ * | Get min 		O(1)   	  | Emplace  O(log(M)), amortized    |
+ * | Delete min 	O(log(M)+log(R)) | Spill  O(M*log(M)), every M/2 emplace |
+ * |------------------------------|---------------------------------|
+ */
+template <class T, class Key = py_t, class Compare = std::less<Key> >
+class ExternalPQ : private KeyCompare<Compare> {
+  static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_copyable<Key>::value,
+                "an external queue needs trivially copyable priorities and values");
+public:
+  typedef std::uint64_t Size;	/**< Type of sizes. */
+  typedef Key Priority;		/**< Type of the priorities. */
+private:
+  struct Record {
+    Key priority;
+    T value;
+  };
+  typedef BinHeapPQ<std::uint32_t, InlineLayout, 4, std::uint32_t, Key, Compare> Heads;
+  /**
+   * A sorted run in a temporary file, deleted when it's closed.
+   */
+  struct Run {
+    std::FILE* file;			/**< The file, read by blocks (null if none). */
+    unsigned level;			/**< Number of merges of its records.       */
+    typename Heads::Handle handle;	/**< Its head in heads.                     */
+    std::uint64_t unread;		/**< Records not read (or in reading) yet.  */
+    std::uint64_t left;			/**< Records not deleted yet.               */
+    std::vector<Record> block;		/**< The current block.                     */
+    std::size_t head;			/**< Position of the head in block.         */
+    std::vector<Record> next;		/**< The next block, while it's read.       */
+    std::size_t pending;		/**< Records of the next block, 0 if none.  */
+#ifdef EXTERNALPQ_POSIX
+    std::uint64_t offset;		/**< Bytes of the blocks read ahead.        */
+#else
+    std::future<std::size_t> reading;	/**< The read of the next block.            */
+#endif
+    Run(std::FILE* file, std::uint64_t count) : file(file), level(0), unread(count), left(count), head(0), pending(0) {
+#ifdef EXTERNALPQ_POSIX
+      offset = 0;
+#endif
+    }
+    ~Run();
+  };
+  typedef BinHeapPQ<T, InlineLayout, 4, std::uint32_t, Key, Compare> Memory;
+  Memory memory;			/**< The best items, in memory.             */
+  std::uint32_t memoryItems;		/**< Capacity of memory.                    */
+  std::uint32_t memorySize;		/**< Items in memory.                       */
+  std::size_t blockItems;		/**< Records in a block of a run.           */
+  unsigned maxRuns;			/**< Runs of a level before a merge.        */
+  std::vector<std::unique_ptr<Run> > runs; /**< The runs (null if closed).       */
+  std::vector<unsigned> levelRuns;	/**< Number of open runs of every level.    */
+  std::vector<std::uint32_t> freeRuns;	/**< Indexes of the closed runs.            */
+  Heads heads;				/**< Index of every open run, by its head.  */
+  std::uint64_t spilledItems;		/**< Items in the runs.                     */
+  bool less(const Key& a, const Key& b) const { return this->compare()(a, b); }
+  bool fromMemory() { return memorySize > 0 && (heads.isEmpty() || !less(heads.minPriority(), memory.minPriority())); }
+  const Record& headOf(std::uint32_t r) const { return runs[r]->block[runs[r]->head]; }
+  void prefetch(Run&);
+  bool fill(Run&);
+  void add(std::unique_ptr<Run>, unsigned);
+  bool open(std::FILE*, std::uint64_t, unsigned);
+  bool next(Run&);
+  void close(std::uint32_t);
+  void advance(std::uint32_t);
+  bool write(const Record*, std::size_t);
+  bool spill();
+  bool mergeRuns(unsigned);
+public:
+  ExternalPQ(std::uint32_t, std::size_t = 4096, unsigned = 64, const Compare& = Compare());
+  ExternalPQ(const ExternalPQ&) = delete;
+  ExternalPQ& operator=(const ExternalPQ&) = delete;
+  bool isEmpty() { return memorySize == 0 && spilledItems == 0; }
+  Size count() const { return memorySize + spilledItems; }
+  Size spilled() const { return spilledItems; }
+  std::size_t openRuns() const { return runs.size() - freeRuns.size(); }
+  bool emplace(const Key&, const T&);
+  T min(); // throw an exception if heap is empty
+  const Key& minPriority(); // throw an exception if heap is empty
+  void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+};
+
+/**
+ * Wait the read in progress (if any) and close the file.
+ */
+template <class T, class Key, class Compare>
+ExternalPQ<T, Key, Compare>::Run::~Run() {
+#ifndef EXTERNALPQ_POSIX
+  if (reading.valid())
+    reading.wait();
+#endif
+  if (file)
+    std::fclose(file);
+}
+
+/**
+ * Init the queue; all the memory for the items is allocated here. O(M).
+ *
+ * @param memoryItems The number of items kept in memory, at least 2.
+ * @param blockItems The number of records read from a run at once.
+ * @param maxRuns The number of runs of a level which are merged into one.
+ * @param compare The comparator of the priorities.
+ */
+template <class T, class Key, class Compare>
+ExternalPQ<T, Key, Compare>::ExternalPQ(std::uint32_t memoryItems, std::size_t blockItems, unsigned maxRuns, const Compare& compare)
+  : KeyCompare<Compare>(compare), memory(memoryItems < 2 ? 2 : memoryItems, false, compare),
+    heads(maxRuns + 1, true, compare) {
+  this->memoryItems = memoryItems < 2 ? 2 : memoryItems;
+  this->blockItems = blockItems > 0 ? blockItems : 1;
+  this->maxRuns = maxRuns > 1 ? maxRuns : 2;
+  memorySize = 0;
+  spilledItems = 0;
+}
+
+/**
+ * Start the read of the next block of a run: the kernel reads it ahead
+ * (POSIX), or another thread reads it. O(1).
+ *
+ * @param run The run, without a read in progress.
+ */
+template <class T, class Key, class Compare>
+void ExternalPQ<T, Key, Compare>::prefetch(Run& run) {
+  if (run.unread == 0)
+    return; // the last block is already in memory
+  std::size_t n = run.unread < blockItems ? std::size_t(run.unread) : blockItems;
+  run.unread -= n;
+  run.next.resize(n);
+  run.pending = n;
+#ifdef EXTERNALPQ_POSIX
+  ::posix_fadvise(::fileno(run.file), off_t(run.offset), off_t(n * sizeof(Record)), POSIX_FADV_WILLNEED); // only a hint
+  run.offset += n * sizeof(Record);
+#else
+  Record* to = run.next.data();
+  std::FILE* file = run.file;
+  run.reading = std::async(std::launch::async, [file, to, n]() { return std::fread(to, sizeof(Record), n, file); });
+#endif
+}
+
+/**
+ * Make the next block of a run the current one, and prefetch the one after. O(1).
+ *
+ * It waits only if the read of the block isn't done yet (on POSIX, if
+ * the pages read ahead aren't in memory yet).
+ *
+ * @param run The run, with its current block consumed.
+ * @return False if the run is over (or it can't be read).
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::fill(Run& run) {
+  if (run.pending == 0)
+    return false; // nothing more
+#ifdef EXTERNALPQ_POSIX
+  std::size_t n = std::fread(run.next.data(), sizeof(Record), run.pending, run.file);
+#else
+  std::size_t n = run.reading.get();
+#endif
+  bool complete = n == run.pending;
+  run.pending = 0;
+  if (!complete)
+    return false; // a broken file, what is left is lost
+  run.block.swap(run.next);
+  run.head = 0;
+  prefetch(run);
+  return true;
+}
+
+/**
+ * Add a run, with its first block already read, in the heads. O(log(R)).
+ *
+ * @param run The run.
+ * @param level The level of the run.
+ */
+template <class T, class Key, class Compare>
+void ExternalPQ<T, Key, Compare>::add(std::unique_ptr<Run> run, unsigned level) {
+  std::uint32_t r;
+  if (freeRuns.empty()) {
+    r = std::uint32_t(runs.size());
+    runs.push_back(nullptr);
+  } else {
+    r = freeRuns.back();
+    freeRuns.pop_back();
+  }
+  if (levelRuns.size() <= level)
+    levelRuns.resize(level + 1, 0);
+  levelRuns[level]++;
+  run->level = level;
+  spilledItems += run->left;
+  runs[r] = std::move(run);
+  runs[r]->handle = heads.emplace(headOf(r).priority, r);
+}
+
+/**
+ * Add a run of (count) sorted records, from the start of a file. O(B).
+ *
+ * @param file The file, written; closed by the run.
+ * @param count The number of records.
+ * @param level The level of the run.
+ * @return False if the first block can't be read.
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::open(std::FILE* file, std::uint64_t count, unsigned level) {
+  std::rewind(file);
+  std::unique_ptr<Run> run(new Run(file, count));
+  prefetch(*run);
+  if (!fill(*run))
+    return false;
+  add(std::move(run), level);
+  return true;
+}
+
+/**
+ * Delete the head of a run: the next record becomes its head. O(1).
+ *
+ * @param run The run, not in the heads.
+ * @return False if the run is over (or it can't be read).
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::next(Run& run) {
+  spilledItems--;
+  run.left--;
+  return ++run.head < run.block.size() || fill(run);
+}
+
+/**
+ * Close a run which is over. O(1).
+ *
+ * @param r The run, not in the heads.
+ */
+template <class T, class Key, class Compare>
+void ExternalPQ<T, Key, Compare>::close(std::uint32_t r) {
+  spilledItems -= runs[r]->left; // zero, unless the file was broken
+  levelRuns[runs[r]->level]--;
+  runs[r].reset();
+  freeRuns.push_back(r);
+}
+
+/**
+ * Delete the head of the run with the minimum head. O(log(R)).
+ *
+ * @param r The run with the minimum head.
+ */
+template <class T, class Key, class Compare>
+void ExternalPQ<T, Key, Compare>::advance(std::uint32_t r) {
+  heads.deleteMin();
+  if (next(*runs[r]))
+    runs[r]->handle = heads.emplace(headOf(r).priority, r);
+  else
+    close(r);
+}
+
+/**
+ * Write sorted records as a new run. O(n).
+ *
+ * @param records The records.
+ * @param n The number of records.
+ * @return False if the temporary file can't be written.
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::write(const Record* records, std::size_t n) {
+  std::FILE* file = std::tmpfile(); // deleted when it's closed
+  if (!file)
+    return false;
+  if (std::fwrite(records, sizeof(Record), n, file) != n || std::fflush(file) != 0) {
+    std::fclose(file);
+    return false;
+  }
+  return open(file, n, 0);
+}
+
+/**
+ * Move the worst half of the full memory to a new run of level 0. O(M*log(M)).
+ *
+ * The full levels are merged before, from the lowest one.
+ *
+ * @return False if the run can't be written (the memory is unchanged).
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::spill() {
+  for (unsigned l=0; l < levelRuns.size(); l++)
+    if (levelRuns[l] >= maxRuns && !mergeRuns(l))
+      return false;
+  std::vector<Record> sorted(memorySize);
+  for (std::size_t i=0; i < sorted.size(); i++) {
+    sorted[i].priority = memory.minPriority();
+    sorted[i].value = memory.popMin();
+  }
+  std::size_t keep = sorted.size() / 2;
+  bool ok = write(sorted.data() + keep, sorted.size() - keep);
+  if (!ok)
+    keep = sorted.size(); // all back in memory
+  std::vector<std::pair<Key, T> > best;
+  best.reserve(keep);
+  for (std::size_t i=0; i < keep; i++)
+    best.push_back(std::make_pair(sorted[i].priority, sorted[i].value));
+  memorySize = memory.assign(best.begin(), best.end());
+  return ok;
+}
+
+/**
+ * Merge the runs of a level into one run of the next level, with a
+ * sequential pass on every run. O(n*log(R)), n records in the runs.
+ *
+ * Every block is flushed when it's written; at the first failure the merge
+ * stops, and nothing is lost: the runs not over go back in the heads, the
+ * records written are a run of the next level, and the ones taken from the
+ * runs but not written are kept in memory, as a run without a file.
+ *
+ * @param level The level.
+ * @return False if the new run can't be written (only if it can't be read
+ * back, also its records are lost).
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::mergeRuns(unsigned level) {
+  std::FILE* file = std::tmpfile();
+  if (!file)
+    return false;
+  Heads merging(maxRuns, true, this->compare());
+  for (std::uint32_t r=0; r < runs.size(); r++)
+    if (runs[r] && runs[r]->level == level) {
+      heads.erase(runs[r]->handle);
+      merging.emplace(headOf(r).priority, r);
+    }
+  std::vector<Record> buffer;
+  buffer.reserve(blockItems);
+  std::uint64_t count = 0; // records written
+  bool ok = true;
+  while (ok && !merging.isEmpty()) {
+    std::uint32_t r = merging.top();
+    merging.deleteMin();
+    buffer.push_back(headOf(r));
+    if (next(*runs[r]))
+      merging.emplace(headOf(r).priority, r);
+    else
+      close(r);
+    if (buffer.size() == blockItems || merging.isEmpty()) {
+      ok = std::fwrite(buffer.data(), sizeof(Record), buffer.size(), file) == buffer.size() && std::fflush(file) == 0;
+      if (ok) {
+        count += buffer.size();
+        buffer.clear();
+      }
+    }
+  }
+  for (; !merging.isEmpty(); merging.deleteMin()) { // after a failure
+    std::uint32_t r = merging.top();
+    runs[r]->handle = heads.emplace(headOf(r).priority, r);
+  }
+  if (!buffer.empty()) {
+    std::unique_ptr<Run> run(new Run(nullptr, 0));
+    run->block.swap(buffer);
+    run->left = run->block.size();
+    add(std::move(run), level);
+  }
+  if (count == 0) {
+    std::fclose(file);
+    return ok;
+  }
+  return open(file, count, level + 1) && ok;
+}
+
+/**
+ * Function for emplacing a new item. O(log(M)), amortized O(log(M)) with the spills.
+ *
+ * @param priority The priority of the new item.
+ * @param value The value of the new item.
+ * @return False if the memory is full and a run can't be written.
+ */
+template <class T, class Key, class Compare>
+bool ExternalPQ<T, Key, Compare>::emplace(const Key& priority, const T& value) {
+  if (memorySize == memoryItems && !spill())
+    return false;
+  memory.emplace(priority, value);
+  memorySize++;
+  return true;
+}
+
+/**
+ * Function for get the minimum item (the copy of the value). O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Key, class Compare>
+T ExternalPQ<T, Key, Compare>::min() {
+  if (fromMemory())
+    return memory.min();
+  if (!heads.isEmpty())
+    return headOf(heads.top()).value;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the minimum priority, without the value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Key, class Compare>
+const Key& ExternalPQ<T, Key, Compare>::minPriority() {
+  if (fromMemory())
+    return memory.minPriority();
+  if (!heads.isEmpty())
+    return heads.minPriority();
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for delete the minimum priority item. O(log(M)) or O(log(R)).
+ *
+ * The head of a run is replaced by the next record, already in memory
+ * (the current block) or read in advance (the next block).
+ */
+template <class T, class Key, class Compare>
+void ExternalPQ<T, Key, Compare>::deleteMin() {
+  if (fromMemory()) {
+    memory.deleteMin();
+    memorySize--;
+  } else if (!heads.isEmpty())
+    advance(heads.top());
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(M)) or O(log(R)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Key, class Compare>
+T ExternalPQ<T, Key, Compare>::popMin() {
+  T value = min();
+  deleteMin();
+  return value;
+}
+
+#endif
@@ -0,0 +1,511 @@
+/**
+ * @file JournaledPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Crash-consistent priority queue: a BinHeapPQ with a write-ahead log of
+ * its operations, committed in groups, and the snapshots of PQSnapshot.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef JOURNALEDPQ_CPP
+#define JOURNALEDPQ_CPP
+
+#include "PQSnapshot.cpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Value of a journaled queue: the value of the user and the identifier
+ * of the item in the log (the handles don't survive a restart).
+ */
+template <class T>
+struct JournalItem {
+  std::uint64_t id;	/**< Identifier of the item, never reused. */
+  T value;		/**< The value of the user.                */
+};
+
+/**
+ * Priority queue with a write-ahead log.
+ *
+ * Every emplace, decrease, increase, erase and deleteMin is applied to the
+ * queue and appended as a record (op, id, [priority], [value]) to a batch
+ * in memory; the batch is written and synced to the log (group commit)
+ * every batchOps records, or by the first operation after batchMicros
+ * microseconds, or by commit(). An operation is durable once committed.
+ * The age of the batch is checked only by the operations and by poll():
+ * without a next operation, the batchMicros bound holds only if the owner
+ * calls poll() (from its event loop, or a timer) at least that often; no
+ * thread is started, and the queue isn't thread-safe.
+ * If a commit fails, the log is truncated back to the last commit (so a
+ * retry doesn't append the batch after a part of it) and the queue is
+ * failed(): the operations are refused, with a null handle or false,
+ * until a commit succeeds (every operation tries again first).
+ *
+ * At the start, recover() reads the last snapshot and replays the log on
+ * it; checkpoint() writes a new snapshot and empties the log.
+ * Keys and values must be trivially copyable; the handles give the value
+ * of the user as h->item.value.
+ */
+template <class T, class Queue = BinHeapPQ<JournalItem<T> > >
+class JournaledPQ {
+public:
+  typedef typename Queue::Size Size;		/**< Type of positions and sizes. */
+  typedef typename Queue::Priority Priority;	/**< Type of the priorities.      */
+  typedef typename Queue::Handle Handle;	/**< Handle of the inner queue.   */
+private:
+  typedef Priority Key;
+  typedef std::chrono::steady_clock Clock;
+  enum Op : unsigned char { EMPLACE = 1, PRIORITY = 2, DELETE = 3 };
+  static const std::size_t HEADER = 16; /**< "BHPQWAL" + 0, version, sizeof(Key), sizeof(T). */
+  Queue queue;				/**< The queue.                           */
+  std::string path;			/**< The log.                             */
+  std::FILE* log;			/**< The log, open to append, unbuffered. */
+  long committed;			/**< Size of the log at the last commit.  */
+  bool failing;				/**< If the last commit failed.           */
+  std::vector<unsigned char> batch;	/**< The records not committed yet.       */
+  unsigned batched;			/**< Number of records in the batch.      */
+  unsigned batchOps;			/**< Records of a full batch.             */
+  Clock::duration batchTime;		/**< Time of a full batch.                */
+  Clock::time_point batchStart;		/**< Time of the first record of a batch. */
+  std::uint64_t nextId;			/**< Identifier of the next item.         */
+  // private function for internal use
+  static void header(unsigned char*);
+  bool open(const char*);
+  bool reset();
+  bool rewind();
+  bool writable() { return !failing || commit(); }
+  void append(Op, std::uint64_t, const Key*, const T*);
+  template <class Items>
+  std::size_t replay(const unsigned char*, std::size_t, Items&);
+public:
+  JournaledPQ(Size, const char*, unsigned = 64, unsigned = 1000);
+  ~JournaledPQ();
+  JournaledPQ(const JournaledPQ&) = delete;
+  JournaledPQ& operator=(const JournaledPQ&) = delete;
+  bool recover(const char*);
+  bool checkpoint(const char*);
+  bool commit();
+  bool poll();
+  bool failed() const { return failing; }
+  bool isEmpty() { return queue.isEmpty(); }
+  bool isFull() { return queue.isFull(); }
+  T min() { return queue.top().value; }		// throw an exception if heap is empty
+  const T& top() { return queue.top().value; }	// throw an exception if heap is empty
+  const Key& minPriority() { return queue.minPriority(); } // throw an exception if heap is empty
+  Handle emplace(const Key&, const T&);
+  bool contains(Handle pi) { return queue.contains(pi); }
+  bool decrease(const Key&, Handle);
+  bool increase(const Key&, Handle);
+  bool erase(Handle);
+  void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+};
+
+/**
+ * Init the queue and open its log, to append. O(n).
+ *
+ * Call recover before any operation, if the log could have records.
+ *
+ * @param maxSize The maximum size (number of items) of the queue.
+ * @param path The log, created if it doesn't exist.
+ * @param batchOps The records of a group commit (1 syncs every operation).
+ * @param batchMicros The maximum age of an uncommitted record, in microseconds,
+ * checked at every operation and by poll().
+ */
+template <class T, class Queue>
+JournaledPQ<T, Queue>::JournaledPQ(Size maxSize, const char* path, unsigned batchOps, unsigned batchMicros)
+  : queue(maxSize), path(path), log(nullptr), committed(0), failing(false), batched(0),
+    batchOps(batchOps > 0 ? batchOps : 1), batchTime(std::chrono::microseconds(batchMicros)), nextId(0) {
+  if (open("ab") && committed == 0) { // a new log
+    unsigned char h[HEADER];
+    header(h);
+    if (std::fwrite(h, HEADER, 1, log) == 1)
+      committed = HEADER;
+  }
+}
+
+template <class T, class Queue>
+JournaledPQ<T, Queue>::~JournaledPQ() {
+  commit();
+  if (log)
+    std::fclose(log);
+}
+
+/**
+ * The header of a log for these types. O(1).
+ *
+ * @param h Where the HEADER bytes are written.
+ */
+template <class T, class Queue>
+void JournaledPQ<T, Queue>::header(unsigned char* h) {
+  std::uint16_t version = 1, keyBytes = sizeof(Key);
+  std::uint32_t valueBytes = sizeof(T);
+  std::memcpy(h, "BHPQWAL", 8);
+  std::memcpy(h + 8, &version, 2);
+  std::memcpy(h + 10, &keyBytes, 2);
+  std::memcpy(h + 12, &valueBytes, 4);
+}
+
+/**
+ * Open the log without a buffer (a failed write leaves nothing behind to
+ * be written later), and take its size as the last commit. O(1).
+ *
+ * @param mode The mode of fopen.
+ * @return False if the log can't be opened.
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::open(const char* mode) {
+  if (log)
+    std::fclose(log);
+  log = std::fopen(path.c_str(), mode);
+  if (!log)
+    return false;
+  std::setvbuf(log, nullptr, _IONBF, 0);
+  std::fseek(log, 0, SEEK_END);
+  committed = std::ftell(log);
+  return committed >= 0;
+}
+
+/**
+ * Empty the log: only its header is left, synced, and it's open again to append. O(1).
+ *
+ * @return False if the log can't be written.
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::reset() {
+  if (!open("wb"))
+    return false;
+  unsigned char h[HEADER];
+  header(h);
+  bool ok = std::fwrite(h, HEADER, 1, log) == 1;
+#ifdef PQSNAPSHOT_POSIX
+  ok = ok && ::fsync(::fileno(log)) == 0;
+#endif
+  return ok && open("ab"); // to append, also after a truncation
+}
+
+/**
+ * Cut the log back to the last commit, after a failed one. O(1).
+ *
+ * @return False if the log can't be truncated (without POSIX, never).
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::rewind() {
+#ifdef PQSNAPSHOT_POSIX
+  return log && ::ftruncate(::fileno(log), off_t(committed)) == 0;
+#else
+  return false; // the bytes written can't be removed
+#endif
+}
+
+/**
+ * Append a record to the batch, and commit the batch if it's full. O(1), amortized.
+ *
+ * @param op The operation.
+ * @param id The item.
+ * @param priority The new priority (EMPLACE and PRIORITY), or null.
+ * @param value The value (EMPLACE), or null.
+ */
+template <class T, class Queue>
+void JournaledPQ<T, Queue>::append(Op op, std::uint64_t id, const Key* priority, const T* value) {
+  unsigned char record[1 + sizeof(id) + sizeof(Key) + sizeof(T)];
+  std::size_t n = 0;
+  record[n++] = op;
+  std::memcpy(record + n, &id, sizeof(id));
+  n += sizeof(id);
+  if (priority) {
+    std::memcpy(record + n, priority, sizeof(Key));
+    n += sizeof(Key);
+  }
+  if (value) {
+    std::memcpy(record + n, value, sizeof(T));
+    n += sizeof(T);
+  }
+  batch.insert(batch.end(), record, record + n);
+  Clock::time_point now = Clock::now();
+  if (batched++ == 0)
+    batchStart = now;
+  if (batched >= batchOps || now - batchStart >= batchTime)
+    commit();
+}
+
+/**
+ * Write the batch to the log and sync it (group commit). O(batch).
+ *
+ * After a failure the log is truncated to the last commit, before this
+ * write if it couldn't be then: the batch is never written twice.
+ *
+ * @return False if the log can't be written; the batch is kept and the queue is failed().
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::commit() {
+  if (batch.empty())
+    return true; // nothing to do
+  failing = failing && !rewind(); // still failing, if the last attempt can't be removed
+  bool ok = !failing && log && std::fwrite(batch.data(), 1, batch.size(), log) == batch.size();
+#ifdef PQSNAPSHOT_POSIX
+  ok = ok && ::fsync(::fileno(log)) == 0;
+#endif
+  if (!ok) {
+    failing = true;
+    rewind(); // or again at the next attempt
+    return false;
+  }
+  committed += long(batch.size());
+  batch.clear();
+  batched = 0;
+  return true;
+}
+
+/**
+ * Commit the batch if its first record is older than batchMicros (timed group commit). O(1) or O(batch).
+ *
+ * Call it periodically when the operations can stop for a while, so the
+ * records already applied don't wait for the next one to be committed.
+ *
+ * @return False if the batch was due and the log can't be written.
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::poll() {
+  if (batched == 0 || Clock::now() - batchStart < batchTime)
+    return true; // nothing due
+  return commit();
+}
+
+/**
+ * Apply the records of a log to a list of items. O(m).
+ *
+ * Every record sets the state of its item (it's idempotent), so a log can
+ * be replayed also on a snapshot which already has some of its records:
+ * an emplace replaces the item with the same id, a priority change sets
+ * it, a delete marks it dead (a null id). A truncated last record (a
+ * crash while writing) ends the log.
+ *
+ * @param data The records.
+ * @param bytes The size of the records.
+ * @param items The pairs (priority, JournalItem) of the snapshot.
+ * @return The number of records applied.
+ */
+template <class T, class Queue>
+template <class Items>
+std::size_t JournaledPQ<T, Queue>::replay(const unsigned char* data, std::size_t bytes, Items& items) {
+  std::unordered_map<std::uint64_t, std::size_t> index; // id -> position in items
+  index.reserve(items.size());
+  for (std::size_t i=0; i < items.size(); i++) {
+    index[items[i].second.id] = i;
+    if (items[i].second.id >= nextId)
+      nextId = items[i].second.id + 1;
+  }
+  std::vector<bool> dead(items.size(), false);
+  std::size_t records = 0;
+  const std::size_t idBytes = sizeof(std::uint64_t);
+  for (std::size_t n = 0; n < bytes; records++) {
+    Op op = Op(data[n]);
+    std::size_t size = 1 + idBytes + (op != DELETE ? sizeof(Key) : 0) + (op == EMPLACE ? sizeof(T) : 0);
+    if ((op != EMPLACE && op != PRIORITY && op != DELETE) || bytes - n < size)
+      break; // a truncated (or unknown) record: the end of the log
+    JournalItem<T> item;
+    Key priority = Key();
+    std::memcpy(&item.id, data + n + 1, idBytes);
+    if (op != DELETE)
+      std::memcpy(&priority, data + n + 1 + idBytes, sizeof(Key));
+    if (op == EMPLACE)
+      std::memcpy(&item.value, data + n + 1 + idBytes + sizeof(Key), sizeof(T));
+    n += size;
+
+    typename std::unordered_map<std::uint64_t, std::size_t>::iterator it = index.find(item.id);
+    if (op == EMPLACE) {
+      if (it == index.end()) {
+        index[item.id] = items.size();
+        items.push_back(std::make_pair(priority, item));
+        dead.push_back(false);
+      } else {
+        items[it->second] = std::make_pair(priority, item);
+        dead[it->second] = false;
+      }
+      if (item.id >= nextId)
+        nextId = item.id + 1;
+    } else if (it != index.end() && op == PRIORITY)
+      items[it->second].first = priority;
+    else if (it != index.end()) // DELETE
+      dead[it->second] = true;
+  }
+  std::size_t alive = 0;
+  for (std::size_t i=0; i < items.size(); i++)
+    if (!dead[i])
+      items[alive++] = items[i];
+  items.resize(alive);
+  return records;
+}
+
+/**
+ * Rebuild the queue from the last snapshot and the log. O(n+m).
+ *
+ * The items of the snapshot and the records of the log are merged in a
+ * list (see replay), which also gives the next identifier. With an empty
+ * log the queue is loaded from the snapshot as it is (PQSnapshot::load,
+ * no restore at all); otherwise it's built from the list at once (assign,
+ * one heapify instead of a restore for each record), and a new snapshot
+ * replaces the old one and the log (checkpoint).
+ *
+ * @param snapshot The last snapshot; it may not exist yet.
+ * @return False if the snapshot or the log exist and can't be read.
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::recover(const char* snapshot) {
+  commit();
+  FileView records(path.c_str());
+  unsigned char h[HEADER];
+  header(h);
+  if (!log || !records.isValid() || records.size() < HEADER || std::memcmp(records.data(), h, HEADER))
+    return false;
+  std::FILE* exists = std::fopen(snapshot, "rb");
+  if (exists)
+    std::fclose(exists);
+  
+  std::vector<std::pair<Key, JournalItem<T> > > items;
+  if (exists && !PQSnapshot::read<Key, JournalItem<T> >(snapshot, std::back_inserter(items)))
+    return false;
+  if (replay(records.data() + HEADER, records.size() - HEADER, items) == 0) {
+    if (exists)
+      return PQSnapshot::load(queue, snapshot);
+    queue.clear();
+    return true;
+  }
+  if (items.size() > std::numeric_limits<Size>::max())
+    return false;
+  queue.reserve(Size(items.size()));
+  queue.assign(items.begin(), items.end());
+  return checkpoint(snapshot);
+}
+
+/**
+ * Write a snapshot of the queue and empty the log. O(n).
+ *
+ * The snapshot is written in a temporary file and renamed over the old
+ * one, then the log is emptied: a crash in between replays the old log
+ * on the new snapshot, which gives the same state (see replay).
+ *
+ * @param snapshot The snapshot, replaced.
+ * @return False if the snapshot or the log can't be written.
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::checkpoint(const char* snapshot) {
+  if (!commit())
+    return false;
+  std::string temporary = std::string(snapshot) + ".tmp";
+  if (!PQSnapshot::save(queue, temporary.c_str()) || std::rename(temporary.c_str(), snapshot) != 0)
+    return false;
+  return reset();
+}
+
+/**
+ * Function for emplacing a new item, journaled. O(log(n)).
+ *
+ * @param priority The priority of the new item.
+ * @param value The value of the new item.
+ * @return A handle, for monitoring the item created; null if the queue is full or failed().
+ */
+template <class T, class Queue>
+typename JournaledPQ<T, Queue>::Handle JournaledPQ<T, Queue>::emplace(const Key& priority, const T& value) {
+  if (!writable())
+    return nullptr;
+  Handle h = queue.emplace(priority, JournalItem<T>{nextId, value});
+  if (h)
+    append(EMPLACE, nextId++, &priority, &value);
+  return h;
+}
+
+/**
+ * Function for decrease the priority of an item in the queue, journaled. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ * @return False if the item wasn't in the queue, or the queue is failed().
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::decrease(const Key& newPriority, Handle pi) {
+  if (!queue.contains(pi) || !writable())
+    return false; // nothing to do
+  queue.decrease(newPriority, pi);
+  append(PRIORITY, pi->item.id, &pi->priority, nullptr);
+  return true;
+}
+
+/**
+ * Function for increase the priority of an item in the queue, journaled. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ * @return False if the item wasn't in the queue, or the queue is failed().
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::increase(const Key& newPriority, Handle pi) {
+  if (!queue.contains(pi) || !writable())
+    return false; // nothing to do
+  queue.increase(newPriority, pi);
+  append(PRIORITY, pi->item.id, &pi->priority, nullptr);
+  return true;
+}
+
+/**
+ * Function for delete an item, anywhere in the queue, journaled. O(log(n)).
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue, or the queue is failed().
+ */
+template <class T, class Queue>
+bool JournaledPQ<T, Queue>::erase(Handle pi) {
+  if (!queue.contains(pi) || !writable())
+    return false; // already deleted, or refused
+  std::uint64_t id = pi->item.id;
+  queue.erase(pi);
+  append(DELETE, id, nullptr, nullptr);
+  return true;
+}
+
+/**
+ * Function for delete the minimum priority item, journaled. O(log(n)).
+ *
+ * Nothing is deleted if the queue is failed().
+ */
+template <class T, class Queue>
+void JournaledPQ<T, Queue>::deleteMin() {
+  if (queue.isEmpty() || !writable())
+    return; // nothing to delete, or refused
+  std::uint64_t id = queue.top().id;
+  queue.deleteMin();
+  append(DELETE, id, nullptr, nullptr);
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out, journaled. O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception; if it's failed(), a
+ * std::runtime_error (the item isn't deleted).
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Queue>
+T JournaledPQ<T, Queue>::popMin() {
+  T value = queue.top().value; // throw an exception if heap is empty
+  if (!writable())
+    throw std::runtime_error("Journal not writable!");
+  deleteMin();
+  return value;
+}
+
+#endif
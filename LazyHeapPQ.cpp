@@ -0,0 +1,327 @@
+/**
+ * @file LazyHeapPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Priority queue with lazy erase and increase: the items are marked in
+ * O(1) and sorted out when they reach the top, or by a compaction.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef LAZYHEAPPQ_CPP
+#define LAZYHEAPPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <utility>
+
+/**
+ * Value of a lazy queue: the value of the user and the marks of the item.
+ */
+template <class T, class Key>
+struct LazyItem {
+  enum State : unsigned char { LIVE, PENDING, DEAD };
+  T value;	/**< The value of the user.                         */
+  Key pending;	/**< The new priority of a PENDING item.            */
+  State state;	/**< Live, with a pending increase, or erased.      */
+  template <class... Args>
+  LazyItem(std::piecewise_construct_t, Args&&... args)
+    : value(std::forward<Args>(args)...), pending(), state(LIVE) {}
+};
+
+/**
+ * Priority queue with lazy deletion and lazy increase, on a BinHeapPQ.
+ *
+ * erase marks the item dead (a tombstone) and increase records the new
+ * priority as pending, both in O(1) without restores: the priority in
+ * the heap is still a lower bound of the true one, so the heap is legal.
+ * When a marked item reaches the top it's deleted, or its pending
+ * priority is applied (one downRestore); when the tombstones are more
+ * than (threshold) of the items, all of them are removed and all the
+ * pending priorities are applied, then the heap is rebuilt in O(n).
+ * A decrease is eager only if the new priority is below the one in the
+ * heap. The values of the dead items are destroyed when they are removed;
+ * the erase of a full queue is eager, so it never runs out of places.
+ * The handles give the value of the user as h->item.value.
+ */
+template <class T, class Layout = PointerLayout, unsigned Arity = 2, class Pos = pos_t,
+          class Key = py_t, class Compare = std::less<Key>, class Stats = NoStats>
+class LazyHeapPQ : private KeyCompare<Compare> {
+public:
+  typedef BinHeapPQ<LazyItem<T, Key>, Layout, Arity, Pos, Key, Compare, Stats> Queue;
+  typedef Pos Size;				/**< Type of positions and sizes. */
+  typedef Key Priority;				/**< Type of the priorities.      */
+  typedef typename Queue::Handle Handle;	/**< Handle of the inner queue.   */
+private:
+  typedef LazyItem<T, Key> Item;
+  Queue queue;		/**< The heap, with the items marked.          */
+  Pos live;		/**< Number of items not erased.               */
+  Pos dead;		/**< Number of tombstones still in the heap.   */
+  double threshold;	/**< Fraction of tombstones of a compaction.   */
+  // private function for internal use
+  bool less(const Key& a, const Key& b) const { return this->compare()(a, b); }
+  static Item& item(Handle pi) { return const_cast<Item&>(pi->item); } // the items belong to this queue
+  void settle();
+public:
+  LazyHeapPQ(Pos, bool = false, double = 0.25, const Compare& = Compare());
+  bool isEmpty() { return live == 0; }
+  bool isFull();
+  void reserve(Pos n) { queue.reserve(n); }
+  T min(); // throw an exception if heap is empty
+  const T& top(); // throw an exception if heap is empty
+  const Key& minPriority(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(const Key&, Args&&...);
+  bool contains(Handle);
+  void decrease(const Key&, Handle);
+  void increase(const Key&, Handle);
+  bool erase(Handle);
+  void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+  void clear();
+  void compact();
+  PQStats stats() const { return queue.stats(); }
+};
+
+/**
+ * Init the priority queue. O(n).
+ *
+ * @param maxSize The maximum size (number of items, also the dead ones) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ * @param threshold The fraction of tombstones which triggers a compaction.
+ * @param compare The comparator of the priorities.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::LazyHeapPQ(Pos maxSize, bool growable, double threshold, const Compare& compare)
+  : KeyCompare<Compare>(compare), queue(maxSize, growable, compare) {
+  live = dead = 0;
+  this->threshold = threshold;
+}
+
+/**
+ * Sort out the marked items on the top, until the minimum is a live item. O(log(n)) amortized.
+ *
+ * The dead items are deleted, the pending priorities applied (they move
+ * the items down).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::settle() {
+  while (!queue.isEmpty()) {
+    Handle h = queue.minHandle();
+    if (h->item.state == Item::DEAD) {
+      queue.deleteMin();
+      dead--;
+    } else if (h->item.state == Item::PENDING) {
+      item(h).state = Item::LIVE;
+      queue.increase(h->item.pending, h);
+    } else
+      return; // a live item on the top
+  }
+}
+
+/**
+ * Check if the queue is full; the tombstones are removed before. O(1), or O(n) if compacted.
+ *
+ * @return True only if the queue is full of live items.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::isFull() {
+  if (queue.isFull() && dead > 0)
+    compact();
+  return queue.isFull();
+}
+
+/**
+ * Function for get the minimum value (a copy). O(1), amortized O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+T LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::min() {
+  settle();
+  return queue.top().value;
+}
+
+/**
+ * Function for get a reference to the minimum value. O(1), amortized O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+const T& LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::top() {
+  settle();
+  return queue.top().value;
+}
+
+/**
+ * Function for get the minimum priority. O(1), amortized O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+const Key& LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::minPriority() {
+  settle();
+  return queue.minPriority();
+}
+
+/**
+ * Function for emplacing a new item. O(log(n)).
+ *
+ * If the queue is full and there are tombstones, they are removed before.
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::emplace(const Key& priority, Args&&... args) {
+  if (queue.isFull() && dead > 0)
+    compact();
+  Handle h = queue.emplace(priority, std::piecewise_construct, std::forward<Args>(args)...);
+  if (h)
+    live++;
+  return h;
+}
+
+/**
+ * Check if the item of a handle is still in the queue, and not erased. O(1).
+ *
+ * @param pi The handle of the item.
+ * @return False if the handle is null or the item was deleted.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::contains(Handle pi) {
+  return queue.contains(pi) && pi->item.state != Item::DEAD;
+}
+
+/**
+ * Function for decrease the priority of an item in the queue. O(1) or O(log(n)).
+ *
+ * Only a priority lesser than the one in the heap restores it; a greater
+ * one (the item had a pending increase) is still pending.
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::decrease(const Key& newPriority, Handle pi) {
+  if (!contains(pi))
+    return; // a stale handle
+  Item& it = item(pi);
+  const Key& current = (it.state == Item::PENDING) ? it.pending : pi->priority;
+  if (!less(newPriority, current))
+    return; // if the newPriority isn't lesser then the current priority, nothing to do
+  if (less(pi->priority, newPriority))
+    it.pending = newPriority; // still above the one in the heap
+  else {
+    it.state = Item::LIVE;
+    queue.decrease(newPriority, pi);
+  }
+}
+
+/**
+ * Function for increase the priority of an item in the queue, lazily. O(1).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::increase(const Key& newPriority, Handle pi) {
+  if (!contains(pi))
+    return; // a stale handle
+  Item& it = item(pi);
+  const Key& current = (it.state == Item::PENDING) ? it.pending : pi->priority;
+  if (!less(current, newPriority))
+    return; // if the newPriority isn't greater then the current priority, nothing to do
+  it.pending = newPriority;
+  it.state = Item::PENDING;
+}
+
+/**
+ * Function for delete an item, lazily: it's marked dead. O(1), or O(n) if compacted.
+ *
+ * In a full queue the item is deleted at once, O(log(n)): a tombstone
+ * would take the place of the next item.
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::erase(Handle pi) {
+  if (!contains(pi))
+    return false; // already deleted
+  live--;
+  if (queue.isFull())
+    return queue.erase(pi);
+  item(pi).state = Item::DEAD;
+  dead++;
+  if (dead > threshold * (double(live) + dead))
+    compact();
+  return true;
+}
+
+/**
+ * Function for delete the minimum priority item. O(log(n)), amortized.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::deleteMin() {
+  settle();
+  if (queue.isEmpty())
+    return; // nothing to delete
+  queue.deleteMin();
+  live--;
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(n)), amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+T LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::popMin() {
+  settle();
+  T value(std::move(queue.popMin().value)); // throw an exception if heap is empty
+  live--;
+  return value;
+}
+
+/**
+ * Function for delete all the items in the queue. O(n).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::clear() {
+  queue.clear();
+  live = dead = 0;
+}
+
+/**
+ * Remove all the tombstones and apply all the pending priorities. O(n).
+ *
+ * Called by erase past the threshold, and when a full queue has tombstones.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void LazyHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::compact() {
+  queue.rebuild([](Key& priority, Item& it) {
+    if (it.state == Item::PENDING) {
+      priority = it.pending;
+      it.state = Item::LIVE;
+    }
+    return it.state != Item::DEAD;
+  });
+  dead = 0;
+}
+
+#endif
@@ -0,0 +1,580 @@
+/**
+ * @file MinMaxHeapPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Double-ended priority queue, implemented with a min-max heap on the
+ * storage of BinHeapPQ: both the minimum and the maximum in O(1).
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef MINMAXHEAPPQ_CPP
+#define MINMAXHEAPPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <stdexcept>
+
+/**
+ * Double-ended priority queue, static dimension, implemented with a
+ * min-max heap (Atkinson et al.): a binary heap where the nodes on the
+ * even levels (the root is level 0) are the minimum of their sub-tree and
+ * the nodes on the odd levels are the maximum. The minimum is the root,
+ * the maximum is one of its children.
+ *
+ * The items, the layouts (PointerLayout or InlineLayout; a BlockLayout is
+ * stored as InlineLayout, the B-heap shape doesn't apply), the handles,
+ * the growable capacity and the Stats policy are the ones of BinHeapPQ;
+ * deleteMax and popMax are counted as DELETE_MIN.
+ * "Decrease" moves an item towards the minimum, "increase" towards the maximum.
+ *
+ * |------------------------------|---------------------------|
+ * | Get min, get max	O(1)   	  | Init 		O(n)  |
+ * | "Is empty?" 	O(1)	  | Destroy 		O(n)  |
+ * | Emplace new item 	O(log(n)) | Mem        		O(n)  |
+ * | De/In-crease key 	O(log(n)) | Assign (heapify)	O(n)  |
+ * | Delete min, max 	O(log(n)) | Erase item		O(log(n)) |
+ * |------------------------------|---------------------------|
+ */
+template <class T, class Layout = PointerLayout, class Pos = pos_t,
+          class Key = py_t, class Compare = std::less<Key>, class Stats = NoStats>
+class MinMaxHeapPQ : private KeyCompare<Compare>, private Stats {
+  static_assert(std::is_unsigned<Pos>::value, "the position type must be unsigned");
+public:
+  typedef Pos Size;				/**< Type of positions and sizes.      */
+  typedef Key Priority;				/**< Type of the priorities.           */
+  typedef ItemHandle<T, Pos, Key> Handle;	/**< Checked read-only pointer to an item. */
+private:
+  typedef typename std::conditional<std::is_same<Layout, PointerLayout>::value,
+    PointerLayout::Heap<T, Pos, Key>, InlineLayout::Heap<T, Pos, Key> >::type Storage;
+  Pos maxSize;			/**< Max number of element stored in heap.     */
+  Pos size;			/**< Current size (number of element) of heap. */
+  bool growable;		/**< If the capacity grows when it's full.     */
+  Storage heap;			/**< min-max heap and its storage.             */
+  // private function for internal use
+  bool less(const Key& a, const Key& b) const { return this->compare()(a, b); }
+  bool before(const Key& a, const Key& b, bool minLevel) const { return minLevel ? less(a, b) : less(b, a); }
+  static bool isMinLevel(std::size_t);
+  static std::size_t parent(std::size_t i) { return (i-1) / 2; }
+  Pos maxPosition() const;
+  Pos upRestore(Pos);
+  void downRestore(Pos);
+  void restore(Pos);
+  void heapify();
+  void deleteAt(Pos);
+  bool grow();
+public:
+  MinMaxHeapPQ(Pos, bool = false, const Compare& = Compare());
+  ~MinMaxHeapPQ();
+  bool isEmpty();
+  bool isFull();
+  void reserve(Pos);
+  T min(); // throw an exception if heap is empty
+  T max(); // throw an exception if heap is empty
+  const Key& minPriority(); // throw an exception if heap is empty
+  const Key& maxPriority(); // throw an exception if heap is empty
+  Handle minHandle(); // throw an exception if heap is empty
+  Handle maxHandle(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(const Key&, Args&&...);
+  bool contains(Handle);
+  void decrease(const Key&, Handle);
+  void increase(const Key&, Handle);
+  bool erase(Handle);
+  void deleteMin();
+  void deleteMax();
+  T popMin(); // throw an exception if heap is empty
+  T popMax(); // throw an exception if heap is empty
+  void clear();
+  template <class InputIt>
+  Pos assign(InputIt, InputIt);
+  PQStats stats() const { return Stats::snapshot(); }
+  void resetStats() { Stats::reset(); }
+};
+
+/**
+ * Init the priority queue. O(n).
+ *
+ * @param maxSize The maximum size (number of items) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ * @param compare The comparator of the priorities.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::MinMaxHeapPQ(Pos maxSize, bool growable, const Compare& compare)
+  : KeyCompare<Compare>(compare), heap(maxSize) {
+  this->maxSize = maxSize;
+  this->growable = growable;
+  size = 0;
+}
+
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::~MinMaxHeapPQ() { // O(size) <= O(n)
+  clear(); // the layout releases the memory
+}
+
+/**
+ * Check if a position is on a min level (an even one). O(log(n)).
+ *
+ * @param i The position.
+ * @return True if the node is the minimum of its sub-tree.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+bool MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::isMinLevel(std::size_t i) {
+  bool even = true;
+  for (i++; i > 1; i >>= 1) // the level is floor(log2(i+1))
+    even = !even;
+  return even;
+}
+
+/**
+ * Check if the priority queue is empty. O(1).
+ *
+ * @return True only if the current size is zero.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+bool MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::isEmpty() {
+  return (size == 0);
+}
+
+/**
+ * Check if the priority queue id full. O(1).
+ *
+ * A growable queue is full only when it can't grow anymore.
+ *
+ * @return True only if the current size is the maximum size.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+bool MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::isFull() {
+  return (size == maxSize) && !(growable && maxSize < std::numeric_limits<Pos>::max());
+}
+
+/**
+ * Function for enlarge the queue, so it can store (n) items without allocating. O(n).
+ *
+ * It works also if the queue isn't growable; it never shrinks the queue.
+ *
+ * @param n The number of items.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::reserve(Pos n) {
+  if (n <= maxSize)
+    return; // nothing to do
+  heap.grow(maxSize, n);
+  maxSize = n;
+}
+
+/**
+ * Double the capacity of a full growable queue. O(n), amortized O(1).
+ *
+ * @return False if the queue isn't growable or can't grow anymore.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+bool MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::grow() {
+  if (!growable || maxSize == std::numeric_limits<Pos>::max())
+    return false;
+  typename Stats::Stamp start = Stats::start();
+  if (maxSize > std::numeric_limits<Pos>::max() / 2)
+    reserve(std::numeric_limits<Pos>::max());
+  else
+    reserve(maxSize > 0 ? 2*maxSize : 1);
+  Stats::stop(PQStats::GROW, start);
+  return true;
+}
+
+/**
+ * Position of the maximum item: the root or one of its children. O(1).
+ *
+ * @return The position; the queue must not be empty.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+Pos MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::maxPosition() const {
+  if (size < 3)
+    return size - 1;
+  return less(heap.priority(1), heap.priority(2)) ? 2 : 1;
+}
+
+/**
+ * Function for get the minimum item (the copy of the value). O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+T MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::min() {
+  if (size > 0)
+    return heap.item(0)->item;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the maximum item (the copy of the value). O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+T MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::max() {
+  if (size > 0)
+    return heap.item(maxPosition())->item;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the minimum priority, without the value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+const Key& MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::minPriority() {
+  if (size > 0)
+    return heap.priority(0);
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the maximum priority, without the value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the maximum item.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+const Key& MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::maxPriority() {
+  if (size > 0)
+    return heap.priority(maxPosition());
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the handle of the minimum item. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The handle of the item associated to the minimum priority.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+typename MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::Handle
+MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::minHandle() {
+  if (size > 0)
+    return Handle(heap.item(0), heap.generation(heap.item(0)));
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the handle of the maximum item. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The handle of the item associated to the maximum priority.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+typename MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::Handle
+MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::maxHandle() {
+  if (size > 0)
+    return Handle(heap.item(maxPosition()), heap.generation(heap.item(maxPosition())));
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Bottom-up restore along the levels of the same kind. O(log(n)).
+ *
+ * The item in position (i) is lifted out: while it's before its
+ * grandparent (lesser on the min levels, greater on the max levels)
+ * the grandparent is moved down into the hole. Working only if the item
+ * is already in order with its parent.
+ *
+ * @param i The position of item to check/restore.
+ * @return The final position of the item.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+Pos MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::upRestore(Pos i) {
+  typename Storage::Entry moving = heap.get(i);
+  const Key& priority = heap.key(moving);
+  bool minLevel = isMinLevel(i);
+  while (i > 2 && before(priority, heap.priority(parent(parent(i))), minLevel)) {
+    Pos grandparent = parent(parent(i));
+    heap.put(i, heap.get(grandparent)); // move the grandparent down, into the hole
+    i = grandparent;
+    Stats::siftUp();
+    Stats::swap();
+  }
+  heap.put(i, moving);
+  return i;
+}
+
+/**
+ * Top-down restore of the heap. O(log(n)).
+ *
+ * If the item in position (i) is after some of its descendants, the
+ * first of its children and grandchildren (the minimum on a min level,
+ * the maximum on a max level) is moved up into the hole; when it's a
+ * grandchild, the item is also compared with the parent of the hole,
+ * on a level of the other kind, and exchanged with it if they are out
+ * of order. Working only if the sub-heaps of the children are legal.
+ *
+ * @param i The position of item to check/restore.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::downRestore(Pos i) {
+  typename Storage::Entry moving = heap.get(i);
+  const Key* priority = &heap.key(moving); // it changes with moving
+  bool minLevel = isMinLevel(i);
+  while (2*std::size_t(i) + 1 < size) { // (i) has at least one child
+    std::size_t first = 2*std::size_t(i) + 1;
+    std::size_t best = first;
+    if (first+1 < size && before(heap.priority(first+1), heap.priority(best), minLevel))
+      best = first+1;
+    for (std::size_t g = 2*first + 1; g < 2*first + 5 && g < size; g++) // the grandchildren
+      if (before(heap.priority(g), heap.priority(best), minLevel))
+        best = g;
+    if (!before(heap.priority(best), *priority, minLevel))
+      break; // nothing to do, heap is restored, exit
+    heap.put(i, heap.get(best)); // move the descendant up, into the hole
+    i = Pos(best);
+    Stats::siftDown();
+    Stats::swap();
+    if (best < first+2)
+      break; // a child has no descendants in order with the item
+    Pos p = Pos(parent(best));
+    if (before(heap.priority(p), *priority, minLevel)) { // the item goes up in the parent, the parent in the hole
+      typename Storage::Entry tmp = heap.get(p);
+      heap.put(p, moving);
+      moving = tmp;
+      priority = &heap.key(moving);
+      Stats::swap();
+    }
+  }
+  heap.put(i, moving);
+}
+
+/**
+ * Restore of an item, at any position, after its priority changed. O(log(n)).
+ *
+ * If the item is out of order with its parent, they are exchanged: the
+ * item climbs the levels of the parent, and the parent goes down from
+ * the position of the item. Otherwise the item climbs, or goes down, on
+ * the levels of its own kind.
+ *
+ * @param i The position of item to check/restore.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::restore(Pos i) {
+  if (i > 0 && before(heap.priority(i), heap.priority(parent(i)), !isMinLevel(i))) {
+    Pos p = Pos(parent(i));
+    heap.swap(i, p);
+    Stats::siftUp();
+    Stats::swap();
+    upRestore(p);
+    downRestore(i); // the parent was in order only with the ancestors
+  } else if (upRestore(i) == i)
+    downRestore(i);
+}
+
+/**
+ * Floyd's bottom-up construction of the heap. O(n).
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::heapify() {
+  if (size < 2)
+    return; // nothing to do
+  for (std::size_t i = parent(size-1) + 1; i-- > 0; )
+    downRestore(Pos(i));
+}
+
+/**
+ * Function for emplacing a new item. O(log(n)).
+ *
+ * The value is constructed in place from the arguments.
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::Handle
+MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::emplace(const Key& priority, Args&&... args) {
+  typename Stats::Stamp start = Stats::start();
+  if (size >= maxSize && !grow()) {
+    Stats::rejected();
+    return nullptr; // if the queue if full, exit
+  }
+  // heap[size] already refers to a free slot of the pool, construct in it
+  PriorityItem<T, Pos, Key>* newPriorityItem = heap.construct(size, priority, std::forward<Args>(args)...);
+  size++;
+  restore(size-1); // a leaf, it only climbs
+  Stats::resized(size);
+  Stats::stop(PQStats::EMPLACE, start);
+  return Handle(newPriorityItem, heap.generation(newPriorityItem)); // return control handle
+}
+
+/**
+ * Check if the item of a handle is still in the queue. O(1).
+ *
+ * @param pi The handle of the item.
+ * @return False if the handle is null or the item was deleted.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+bool MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::contains(Handle pi) {
+  return pi && heap.generation(pi.get()) == pi.generation();
+}
+
+/**
+ * Function for decrease the priority of an item in the queue. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::decrease(const Key& newPriority, Handle pi) {
+  if (!contains(pi) || !less(newPriority, pi->priority))
+    return; // if the newPriority isn't lesser then the current priority, nothing to do
+  typename Stats::Stamp start = Stats::start();
+  Pos i = heap.position(pi.get());
+  heap.setPriority(i, newPriority);
+  restore(i);
+  Stats::stop(PQStats::DECREASE, start);
+}
+
+/**
+ * Function for increase the priority of an item in the queue. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::increase(const Key& newPriority, Handle pi) {
+  if (!contains(pi) || !less(pi->priority, newPriority))
+    return; // if the newPriority isn't greater then the current priority, nothing to do
+  typename Stats::Stamp start = Stats::start();
+  Pos i = heap.position(pi.get());
+  heap.setPriority(i, newPriority);
+  restore(i);
+  Stats::stop(PQStats::INCREASE, start);
+}
+
+/**
+ * Delete the item in position (i): the last item takes its position. O(log(n)).
+ *
+ * @param i The position, lesser than the size.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::deleteAt(Pos i) {
+  if (i != size-1) {
+    heap.swap(i, size-1);
+    Stats::swap();
+  }
+  heap.destroy(size-1); // the slot stays in heap[size] as free
+  size--;
+  if (i < size)
+    restore(i);
+}
+
+/**
+ * Function for delete an item, anywhere in the queue. O(log(n)).
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+bool MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::erase(Handle pi) {
+  if (!contains(pi))
+    return false; // already deleted
+  typename Stats::Stamp start = Stats::start();
+  deleteAt(heap.position(pi.get()));
+  Stats::stop(PQStats::ERASE, start);
+  return true;
+}
+
+/**
+ * Function for delete the minimum priority item (and update the queue). O(log(n)).
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::deleteMin() {
+  if (size <= 0)
+    return; // nothing to delete
+  typename Stats::Stamp start = Stats::start();
+  deleteAt(0);
+  Stats::stop(PQStats::DELETE_MIN, start);
+}
+
+/**
+ * Function for delete the maximum priority item (and update the queue). O(log(n)).
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::deleteMax() {
+  if (size <= 0)
+    return; // nothing to delete
+  typename Stats::Stamp start = Stats::start();
+  deleteAt(maxPosition());
+  Stats::stop(PQStats::DELETE_MIN, start);
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+T MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::popMin() {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  T value(std::move(heap.item(0)->item));
+  deleteMin();
+  return value;
+}
+
+/**
+ * Function for delete the maximum priority item, moving its value out. O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the maximum priority.
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+T MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::popMax() {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  T value(std::move(heap.item(maxPosition())->item));
+  deleteMax();
+  return value;
+}
+
+/**
+ * Function for delete all the items in the queue. O(n).
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+void MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::clear() {
+  for (Pos i=0; i < size; i++)
+    heap.destroy(i); // the slots stay in the heap array as free
+  size = 0;
+}
+
+/**
+ * Function for replacing the content of the queue with a range of items. O(n).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<py_t, T>.
+ * @param last The end of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, class Pos, class Key, class Compare, class Stats>
+template <class InputIt>
+Pos MinMaxHeapPQ<T, Layout, Pos, Key, Compare, Stats>::assign(InputIt first, InputIt last) {
+  clear();
+  for (; first != last && (size < maxSize || grow()); ++first, size++)
+    heap.construct(size, first->first, first->second);
+  heapify();
+  Stats::resized(size);
+  return size;
+}
+
+#endif
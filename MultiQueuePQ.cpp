@@ -0,0 +1,47 @@
+/**
+ * @file MultiQueuePQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Relaxed concurrent priority queue made of many BinHeapPQ ("MultiQueue").
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef MULTIQUEUEPQ_CPP
+#define MULTIQUEUEPQ_CPP
+
+#include "ConcurrentPQ.cpp"
+
+/**
+ * MultiQueue: (c*threads) sub-heaps, each one with its spin lock and
+ * aligned to the cache line; it's the ConcurrentPQ with RelaxedOrder,
+ * sized by the number of threads.
+ *
+ * An emplace goes into a random sub-heap; a pop deletes the minimum of the
+ * better of two random sub-heaps. A greater (c) means less contention but
+ * a greater rank error (how many items are better than the one deleted),
+ * which grows as O(c*threads) on average.
+ */
+template <class T, class Queue = BinHeapPQ<T> >
+class MultiQueuePQ : public ConcurrentPQ<T, RelaxedOrder, Queue> {
+public:
+  typedef typename ConcurrentPQ<T, RelaxedOrder, Queue>::Size Size;
+  MultiQueuePQ(Size, unsigned, unsigned = 2);
+};
+
+/**
+ * Init the sub-heaps. O(n).
+ *
+ * @param maxSize The maximum size (number of items) of each sub-heap.
+ * @param threads The number of threads that will use the queue.
+ * @param c The number of sub-heaps for each thread.
+ */
+template <class T, class Queue>
+MultiQueuePQ<T, Queue>::MultiQueuePQ(Size maxSize, unsigned threads, unsigned c)
+  : ConcurrentPQ<T, RelaxedOrder, Queue>(maxSize, (threads > 0 ? threads : 1) * (c > 0 ? c : 1)) {
+}
+
+#endif
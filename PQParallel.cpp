@@ -0,0 +1,250 @@
+/**
+ * @file PQParallel.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Parallel bulk operations on a BinHeapPQ: the construction of the heap
+ * (heapify) and the extraction of all the items before a priority.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef PQPARALLEL_CPP
+#define PQPARALLEL_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Executor which runs every task in the calling thread: the parallel
+ * operations are the sequential ones of BinHeapPQ.
+ *
+ * An executor is anything with concurrency() (the number of tasks worth
+ * running at once) and run(n, f), which calls f(0) ... f(n-1), possibly
+ * in parallel, and returns when all are done: a thread pool can be
+ * plugged in with these two members.
+ */
+class SerialExecutor {
+public:
+  unsigned concurrency() const { return 1; }
+  template <class F>
+  void run(unsigned n, F f) {
+    for (unsigned i=0; i < n; i++)
+      f(i);
+  }
+};
+
+/**
+ * Executor which runs every task in a new thread (the first one in the
+ * calling thread); compile with -pthread.
+ */
+class ThreadExecutor {
+private:
+  unsigned threads; /**< Number of threads. */
+public:
+  ThreadExecutor(unsigned threads = std::thread::hardware_concurrency()) : threads(threads > 0 ? threads : 1) {}
+  unsigned concurrency() const { return threads; }
+  template <class F>
+  void run(unsigned n, F f) {
+    std::vector<std::thread> workers;
+    for (unsigned i=1; i < n; i++)
+      workers.push_back(std::thread(f, i));
+    if (n > 0)
+      f(0);
+    for (std::size_t i=0; i < workers.size(); i++)
+      workers[i].join();
+  }
+};
+
+/**
+ * Parallel bulk operations of a BinHeapPQ, on an executor.
+ *
+ * The heap is split in disjoint sub-trees, one range of them for every
+ * task, so the tasks don't share anything but the queue object; the
+ * levels above the sub-trees are restored by the calling thread.
+ * With fewer than grain items, with an executor of concurrency 1, with
+ * BlockLayout (its sub-trees aren't ranges of levels) or with a Stats
+ * policy other than NoStats (its counters aren't atomic) the sequential
+ * code of BinHeapPQ runs, unchanged.
+ */
+class PQParallel {
+private:
+  static const std::size_t grain = std::size_t(1) << 15; /**< Items below which the work isn't split. */
+  template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats, class Executor>
+  static void heapify(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>&, Executor&);
+public:
+  template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats, class InputIt, class Executor>
+  static Pos assign(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>&, InputIt, InputIt, Executor&);
+  template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats, class OutputIt, class Executor>
+  static Pos popBelow(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>&,
+                      const typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Priority&, OutputIt, Executor&);
+};
+
+/**
+ * Floyd's construction of the heap, in parallel. O(n/t + t*log(n)).
+ *
+ * The roots of the sub-trees are the first level with 4 nodes per task
+ * at least; the descendants of a range of nodes are a range of every
+ * level below, so a task restores its ranges bottom-up, as heapify does.
+ *
+ * @param q The queue, its items in any order.
+ * @param executor Where the tasks run.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats, class Executor>
+void PQParallel::heapify(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>& q, Executor& executor) {
+  typedef typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Shape Shape;
+  unsigned tasks = (Shape::levelOrder && std::is_same<Stats, NoStats>::value) ? executor.concurrency() : 1;
+  std::size_t size = q.size;
+  if (tasks < 2 || size < grain) {
+    q.heapify(); // sequential
+    return;
+  }
+  std::size_t start = 0, width = 1; // the level of the roots
+  while (width < 4 * std::size_t(tasks) && start + width < size) {
+    start += width;
+    width *= Arity;
+  }
+  std::size_t end = std::min(start + width, size);
+  executor.run(tasks, [&q, start, end, size, tasks](unsigned task) {
+    std::vector<std::pair<std::size_t, std::size_t> > levels;
+    std::size_t lo = start + (end - start) * task / tasks;
+    std::size_t hi = start + (end - start) * (task + 1) / tasks;
+    for (; lo < hi && lo < size; lo = Shape::firstChild(lo), hi = Shape::firstChild(hi))
+      levels.push_back(std::make_pair(lo, std::min(hi, size)));
+    for (std::size_t l = levels.size(); l-- > 0; )
+      for (std::size_t i = levels[l].second; i-- > levels[l].first; )
+        if (Shape::firstChild(i) < size)
+          q.downRestore(Pos(i));
+  });
+  for (std::size_t i = start; i-- > 0; )
+    q.downRestore(Pos(i)); // the levels above the sub-trees
+}
+
+/**
+ * Function for replacing the content of the queue with a range of items,
+ * with a parallel heapify. O(n/t).
+ *
+ * The items are constructed by the calling thread, in the order of the
+ * range (the slots of the pool aren't shared between tasks).
+ *
+ * @param q The queue, cleared.
+ * @param first The begin of a range of pairs (priority, value), like std::pair<py_t, T>.
+ * @param last The end of the range.
+ * @param executor Where the tasks run.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats, class InputIt, class Executor>
+Pos PQParallel::assign(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>& q, InputIt first, InputIt last, Executor& executor) {
+  q.clear();
+  for (; first != last && (q.size < q.maxSize || q.grow()); ++first, q.size++)
+    q.heap.construct(q.size, first->first, first->second);
+  heapify(q, executor);
+  q.Stats::resized(q.size);
+  return q.size;
+}
+
+/**
+ * Function for delete all the items before a priority, moving their values out in order. O(m*log(m)/t + n/t).
+ *
+ * The items before (bound) are a sub-tree containing the root: its top
+ * levels are visited by the calling thread, until there are 4 nodes per
+ * task at least, then every task visits the sub-trees of a range of
+ * nodes, moves their values out and sorts them; the sorted runs are
+ * merged into (out) by the calling thread. The holes are filled with the
+ * last items and restored from the deepest one (as popMin(k) does), or
+ * with a parallel heapify if there are many.
+ *
+ * @param q The queue.
+ * @param bound The priority; the items before it (for Compare) are deleted.
+ * @param out Where the values are moved, in order of priority.
+ * @param executor Where the tasks run.
+ * @return The number of items deleted.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats, class OutputIt, class Executor>
+Pos PQParallel::popBelow(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>& q,
+                         const typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Priority& bound,
+                         OutputIt out, Executor& executor) {
+  typedef std::pair<Key, T> Item;
+  if (q.size == 0 || !q.less(q.heap.priority(0), bound))
+    return 0; // nothing to delete
+  unsigned tasks = executor.concurrency() > 0 ? executor.concurrency() : 1;
+  std::vector<std::vector<std::size_t> > positions(tasks + 1); // the last one for the top levels
+  std::vector<std::vector<Item> > runs(tasks + 1);
+  std::vector<std::size_t> frontier(1, 0), next;
+  while (!frontier.empty() && frontier.size() < 4 * std::size_t(tasks)) {
+    next.clear();
+    for (std::size_t j=0; j < frontier.size(); j++) {
+      std::size_t i = frontier[j];
+      positions[tasks].push_back(i);
+      runs[tasks].push_back(Item(q.heap.priority(i), std::move(q.heap.item(i)->item)));
+      for (std::size_t c = q.firstChild(i); c < q.firstChild(i) + Arity && c < q.size; c++)
+        if (q.less(q.heap.priority(c), bound))
+          next.push_back(c);
+    }
+    frontier.swap(next);
+  }
+  auto before = [&q](const Item& a, const Item& b) { return q.less(a.first, b.first); };
+  executor.run(tasks, [&](unsigned task) {
+    std::vector<std::size_t> stack(frontier.begin() + frontier.size() * task / tasks,
+                                   frontier.begin() + frontier.size() * (task + 1) / tasks);
+    while (!stack.empty()) {
+      std::size_t i = stack.back();
+      stack.pop_back();
+      positions[task].push_back(i);
+      runs[task].push_back(Item(q.heap.priority(i), std::move(q.heap.item(i)->item)));
+      for (std::size_t c = q.firstChild(i); c < q.firstChild(i) + Arity && c < q.size; c++)
+        if (q.less(q.heap.priority(c), bound))
+          stack.push_back(c);
+    }
+    std::sort(runs[task].begin(), runs[task].end(), before);
+  });
+  std::sort(runs[tasks].begin(), runs[tasks].end(), before);
+
+  // k-way merge of the sorted runs
+  typedef std::pair<std::size_t, std::size_t> Head; // (run, position in the run)
+  auto later = [&runs, &before](const Head& a, const Head& b) { return before(runs[b.first][b.second], runs[a.first][a.second]); };
+  std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+  std::size_t count = 0;
+  for (std::size_t r=0; r < runs.size(); r++) {
+    count += runs[r].size();
+    if (!runs[r].empty())
+      heads.push(Head(r, 0));
+  }
+  while (!heads.empty()) {
+    Head h = heads.top();
+    heads.pop();
+    *out++ = std::move(runs[h.first][h.second].second);
+    if (++h.second < runs[h.first].size())
+      heads.push(h);
+  }
+
+  // delete from the deepest: the last item never is one still to delete
+  std::vector<std::size_t> selected;
+  selected.reserve(count);
+  for (std::size_t r=0; r < positions.size(); r++)
+    selected.insert(selected.end(), positions[r].begin(), positions[r].end());
+  std::sort(selected.begin(), selected.end(), std::greater<std::size_t>());
+  for (std::size_t j=0; j < selected.size(); j++) {
+    if (selected[j] != std::size_t(q.size-1))
+      q.heap.swap(selected[j], q.size-1);
+    q.heap.destroy(q.size-1);
+    q.size--;
+  }
+  if (count * 16 > q.size)
+    heapify(q, executor); // cheaper than a restore for every hole
+  else
+    for (std::size_t j=0; j < selected.size(); j++)
+      if (selected[j] < q.size)
+        q.downRestore(selected[j]);
+  q.Stats::resized(q.size);
+  return Pos(count);
+}
+
+#endif
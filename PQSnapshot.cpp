@@ -0,0 +1,330 @@
+/**
+ * @file PQSnapshot.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Snapshot of a BinHeapPQ in a flat file, and its restore without
+ * rebuilding the heap (the file is memory-mapped on POSIX systems).
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef PQSNAPSHOT_CPP
+#define PQSNAPSHOT_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PQSNAPSHOT_POSIX
+#endif
+
+/**
+ * Read-only view of a whole file: mapped in memory with mmap, or read in
+ * a buffer where mmap isn't available. The view is empty if the file
+ * can't be read.
+ */
+class FileView {
+private:
+  const unsigned char* bytes;		/**< The content of the file.     */
+  std::size_t length;			/**< The size of the file.        */
+#ifndef PQSNAPSHOT_POSIX
+  std::vector<unsigned char> buffer;	/**< The content, without mmap.   */
+#endif
+public:
+  FileView(const char*);
+  ~FileView();
+  FileView(const FileView&) = delete;
+  FileView& operator=(const FileView&) = delete;
+  bool isValid() const { return bytes != nullptr; }
+  const unsigned char* data() const { return bytes; }
+  std::size_t size() const { return length; }
+};
+
+/**
+ * Map (or read) a file. O(1) with mmap, O(n) without.
+ *
+ * @param path The file.
+ */
+inline FileView::FileView(const char* path) : bytes(nullptr), length(0) {
+#ifdef PQSNAPSHOT_POSIX
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* map = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      ::madvise(map, std::size_t(st.st_size), MADV_SEQUENTIAL);
+      bytes = static_cast<const unsigned char*>(map);
+      length = std::size_t(st.st_size);
+    }
+  }
+  ::close(fd); // the mapping stays
+#else
+  std::FILE* file = std::fopen(path, "rb");
+  if (!file)
+    return;
+  unsigned char chunk[1 << 16];
+  for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), file)) > 0; )
+    buffer.insert(buffer.end(), chunk, chunk + n);
+  std::fclose(file);
+  if (!buffer.empty()) {
+    bytes = buffer.data();
+    length = buffer.size();
+  }
+#endif
+}
+
+inline FileView::~FileView() {
+#ifdef PQSNAPSHOT_POSIX
+  if (bytes)
+    ::munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+}
+
+/**
+ * Tag of a comparator in a snapshot: 1 for std::less, 2 for std::greater,
+ * 0 for any other one (its order isn't known from the type alone).
+ */
+template <class Compare>
+struct CompareTag {
+  static const std::uint32_t value = 0;
+};
+
+template <class Key>
+struct CompareTag<std::less<Key> > {
+  static const std::uint32_t value = 1;
+};
+
+template <class Key>
+struct CompareTag<std::greater<Key> > {
+  static const std::uint32_t value = 2;
+};
+
+/**
+ * Header of a snapshot file, followed by (count) records of recordBytes,
+ * in the order of the heap array: the position of an item is its index.
+ *
+ * The numbers are in the byte order of the machine which wrote the file;
+ * a file is read only if every field matches the queue type (but the
+ * heap order, see PQSnapshot::load).
+ */
+struct PQSnapshotHeader {
+  static const std::uint32_t VERSION = 2;
+  static const std::uint32_t ENDIAN = 0x01020304;
+  char magic[8];		/**< "BHPQSNAP".                               */
+  std::uint32_t version;	/**< VERSION of the format.                   */
+  std::uint32_t endian;		/**< ENDIAN, as written by the machine.       */
+  std::uint32_t keyBytes;	/**< sizeof(Key).                             */
+  std::uint32_t valueBytes;	/**< sizeof(T).                               */
+  std::uint32_t recordBytes;	/**< sizeof of a record, with the padding.    */
+  std::uint32_t arity;		/**< Arity of the heap.                       */
+  std::uint32_t compare;	/**< CompareTag of the comparator.            */
+  std::uint64_t blockNodes;	/**< Nodes of a block of a B-heap, 0 if none. */
+  std::uint64_t count;		/**< Number of records.                       */
+};
+
+/**
+ * Save and restore of a BinHeapPQ of trivially copyable keys and values.
+ *
+ * The records are (priority, value) pairs, written as raw bytes; the
+ * handles aren't saved (they aren't valid in another process anyway).
+ * A StableHeapPQ isn't supported: the next sequence number isn't saved.
+ */
+class PQSnapshot {
+private:
+  template <class Key, class T>
+  struct Record {
+    Key priority;
+    T value;
+  };
+  template <class Key, class T, class Shape>
+  static PQSnapshotHeader header(unsigned, std::uint32_t, std::uint64_t);
+  template <class Key, class T>
+  static const unsigned char* records(const FileView&, PQSnapshotHeader&);
+  template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+  static bool ordered(const BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>&);
+public:
+  template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+  static bool save(const BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>&, const char*);
+  template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+  static bool load(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>&, const char*);
+  template <class Key, class T, class OutputIt>
+  static bool read(const char*, OutputIt);
+};
+
+/**
+ * The header of a snapshot of a queue, with (count) records. O(1).
+ *
+ * @param arity The arity of the heap, its order is Shape.
+ * @param compare The CompareTag of the comparator.
+ * @param count The number of records.
+ */
+template <class Key, class T, class Shape>
+PQSnapshotHeader PQSnapshot::header(unsigned arity, std::uint32_t compare, std::uint64_t count) {
+  PQSnapshotHeader h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, "BHPQSNAP", 8);
+  h.version = PQSnapshotHeader::VERSION;
+  h.endian = PQSnapshotHeader::ENDIAN;
+  h.keyBytes = sizeof(Key);
+  h.valueBytes = sizeof(T);
+  h.recordBytes = sizeof(Record<Key, T>);
+  h.arity = arity;
+  h.compare = compare;
+  h.blockNodes = Shape::levelOrder ? 0 : Shape::nodes;
+  h.count = count;
+  return h;
+}
+
+/**
+ * Check the header of a snapshot of (Key, T) records. O(1).
+ *
+ * The heap order isn't checked, any order can be read.
+ *
+ * @param file The view of the file.
+ * @param h Where the header is copied.
+ * @return The first record, or null if the file isn't a snapshot of (Key, T).
+ */
+template <class Key, class T>
+const unsigned char* PQSnapshot::records(const FileView& file, PQSnapshotHeader& h) {
+  typedef Record<Key, T> R;
+  PQSnapshotHeader expected = header<Key, T, LevelShape<2> >(2, 0, 0);
+  if (!file.isValid() || file.size() < sizeof(h))
+    return nullptr;
+  std::memcpy(&h, file.data(), sizeof(h));
+  std::size_t bytes = file.size() - sizeof(h);
+  bool ok = !std::memcmp(h.magic, expected.magic, 8) && h.version == expected.version
+    && h.endian == expected.endian && h.keyBytes == expected.keyBytes
+    && h.valueBytes == expected.valueBytes && h.recordBytes == expected.recordBytes
+    && bytes % sizeof(R) == 0 && bytes / sizeof(R) == h.count;
+  return ok ? file.data() + sizeof(h) : nullptr;
+}
+
+/**
+ * Check the heap order of a queue, with its comparator. O(n).
+ *
+ * @param q The queue.
+ * @return True if no item is before its parent.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool PQSnapshot::ordered(const BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>& q) {
+  for (Pos i=1; i < q.size; i++)
+    if (q.less(q.heap.priority(i), q.heap.priority(q.parent(i))))
+      return false;
+  return true;
+}
+
+/**
+ * Write all the items of a queue in a file, in the order of the heap. O(n).
+ *
+ * @param q The queue, unchanged.
+ * @param path The file, created or truncated.
+ * @return False if the file can't be written.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool PQSnapshot::save(const BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>& q, const char* path) {
+  static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_copyable<Key>::value,
+                "a snapshot needs trivially copyable priorities and values");
+  std::FILE* file = std::fopen(path, "wb");
+  if (!file)
+    return false;
+  typedef typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Shape Shape;
+  PQSnapshotHeader h = header<Key, T, Shape>(Arity, CompareTag<Compare>::value, q.size);
+  bool ok = std::fwrite(&h, sizeof(h), 1, file) == 1;
+  Record<Key, T> record;
+  std::memset(&record, 0, sizeof(record)); // no garbage in the padding
+  for (Pos i=0; ok && i < q.size; i++) {
+    std::memcpy(&record.priority, &q.heap.priority(i), sizeof(Key));
+    std::memcpy(&record.value, &q.heap.item(i)->item, sizeof(T));
+    ok = std::fwrite(&record, sizeof(record), 1, file) == 1;
+  }
+  ok = ok && std::fflush(file) == 0;
+#ifdef PQSNAPSHOT_POSIX
+  ok = ok && ::fsync(::fileno(file)) == 0; // on the disk before it replaces anything
+#endif
+  return (std::fclose(file) == 0) && ok;
+}
+
+/**
+ * Replace the content of a queue with the items of a file. O(n).
+ *
+ * The file is mapped in memory (read in a buffer without mmap) and the
+ * records are written in the same positions of the heap array, one
+ * sequential pass without restores and with one allocation at most
+ * (reserve); only if the file was written by a queue with another heap
+ * order (arity or B-heap blocks) the heap is rebuilt (heapify).
+ * The comparator is trusted only if both are std::less or std::greater
+ * of the same tag; with another comparator (or another tag) the order of
+ * the records is checked with a pass of compares, and the heap is rebuilt
+ * if an item is before its parent.
+ * The queue can be used as soon as the function returns.
+ *
+ * @param q The queue, cleared; unchanged if the file isn't valid.
+ * @param path The file written by save.
+ * @return False if the file can't be read or isn't a snapshot of this type of queue.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool PQSnapshot::load(BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>& q, const char* path) {
+  static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_copyable<Key>::value,
+                "a snapshot needs trivially copyable priorities and values");
+  typedef Record<Key, T> R;
+  typedef typename BinHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Shape Shape;
+  FileView file(path);
+  PQSnapshotHeader h, expected = header<Key, T, Shape>(Arity, CompareTag<Compare>::value, 0);
+  const unsigned char* records = PQSnapshot::records<Key, T>(file, h);
+  bool ok = records && h.count <= std::numeric_limits<Pos>::max();
+  if (ok) {
+    q.clear();
+    q.reserve(Pos(h.count));
+    R record;
+    for (Pos i=0; i < Pos(h.count); i++, q.size++) {
+      std::memcpy(&record, records + std::size_t(i) * sizeof(R), sizeof(R));
+      q.heap.construct(i, record.priority, record.value);
+    }
+    bool same = h.arity == expected.arity && h.blockNodes == expected.blockNodes;
+    bool trusted = h.compare == expected.compare && expected.compare != 0;
+    if (!same || (!trusted && !ordered(q)))
+      q.heapify(); // another heap order, or another comparator
+    q.Stats::resized(q.size);
+  }
+  return ok;
+}
+
+/**
+ * Read the items of a snapshot, in the order of the file. O(n).
+ *
+ * @param path The file written by save, by a queue of any order.
+ * @param out Where the pairs (priority, value) are written.
+ * @return False if the file can't be read or isn't a snapshot of (Key, T) items.
+ */
+template <class Key, class T, class OutputIt>
+bool PQSnapshot::read(const char* path, OutputIt out) {
+  static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_copyable<Key>::value,
+                "a snapshot needs trivially copyable priorities and values");
+  typedef Record<Key, T> R;
+  FileView file(path);
+  PQSnapshotHeader h;
+  const unsigned char* records = PQSnapshot::records<Key, T>(file, h);
+  if (!records)
+    return false;
+  R record;
+  for (std::uint64_t i=0; i < h.count; i++) {
+    std::memcpy(&record, records + std::size_t(i) * sizeof(R), sizeof(R));
+    *out++ = std::make_pair(record.priority, record.value);
+  }
+  return true;
+}
+
+#endif
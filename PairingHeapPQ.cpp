@@ -0,0 +1,556 @@
+/**
+ * @file PairingHeapPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Priority queue implemented with a pairing heap.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef PAIRINGHEAPPQ_CPP
+#define PAIRINGHEAPPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <stdexcept>
+
+/**
+ * Unstable priority queue, static dimension, implemented with a pairing heap.
+ *
+ * The heap is a tree where every node has a list of children, and two trees
+ * are melded in O(1) linking the root with the greater priority under the
+ * other one. Emplace and decrease are a meld with the root; deleteMin melds
+ * the children of the root in pairs (left to right) and then all the pairs
+ * (right to left), the "two-pass" pairing.
+ * The nodes (a copy of the priority and the links, indexed by the slot of
+ * the item) are in their own dense array, so the restores never read the
+ * items; the items are in a pool, as in BinHeapPQ, and the interface and
+ * the handles are the same. The capacity is limited to the maximum of Pos minus one.
+ * Because the links are slots, merge isn't the O(1) meld of a pointer
+ * heap: adopting the pool of the other queue renumbers its (m) nodes,
+ * and when the pool can't be adopted every value is emplaced again.
+ *
+ * |------------------------------|---------------------------|
+ * | Get min 		O(1)   	  | Init 		O(n)  |
+ * | "Is empty?" 	O(1)	  | Destroy 		O(n)  |
+ * | Emplace new item 	O(1)      | Mem        		O(n)  |
+ * | Decrease key 	o(log(n))* | Increase key	O(log(n))* |
+ * | Delete min 	O(log(n))* | Erase item		O(log(n))* |
+ * |------------------------------| Merge			O(m)  |
+ * * amortized			  |---------------------------|
+ */
+template <class T, class Pos = pos_t>
+class PairingHeapPQ {
+  static_assert(std::is_unsigned<Pos>::value, "the position type must be unsigned");
+public:
+  typedef Pos Size;				/**< Type of positions and sizes.      */
+  typedef ItemHandle<T, Pos> Handle;		/**< Checked read-only pointer to an item. */
+private:
+  static constexpr Pos nil = std::numeric_limits<Pos>::max(); /**< No node. */
+  struct Node {
+    py_t priority; /**< Copy of the priority of the item.                 */
+    Pos child;     /**< First child.                                      */
+    Pos sibling;   /**< Next sibling.                                     */
+    Pos prev;      /**< Previous sibling, or the parent of the first child. */
+  };
+  Pos maxSize;			/**< Max number of element stored.             */
+  Pos size;			/**< Current size (number of element).         */
+  bool growable;		/**< If the capacity grows when it's full.     */
+  Pos root;			/**< The node with the minimum priority.       */
+  std::vector<Node> nodes;	/**< The nodes, by slot of the item.           */
+  std::vector<Pos> freeSlots;	/**< Stack of the free slots of the pool.      */
+  ItemPool<PriorityItem<T, Pos>, Pos> pool; /**< Slots of the items.      */
+  // private function for internal use
+  Pos meld(Pos, Pos);
+  void cut(Pos);
+  Pos combine(Pos);
+  void release(Pos);
+  bool grow();
+public:
+  PairingHeapPQ(Pos, bool = false);
+  ~PairingHeapPQ();
+  PairingHeapPQ(const PairingHeapPQ&) = delete;
+  PairingHeapPQ& operator=(const PairingHeapPQ&) = delete;
+  bool isEmpty();
+  bool isFull();
+  void reserve(Pos);
+  T min(); // throw an exception if heap is empty
+  const T& top(); // throw an exception if heap is empty
+  py_t minPriority(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(py_t, Args&&...);
+  bool contains(Handle);
+  void decrease(py_t, Handle);
+  void increase(py_t, Handle);
+  bool erase(Handle);
+  void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+  Pos merge(PairingHeapPQ&&);
+  template <class OutputIt>
+  Pos merge(PairingHeapPQ&&, OutputIt);
+  void clear();
+};
+
+template <class T, class Pos>
+constexpr Pos PairingHeapPQ<T, Pos>::nil;
+
+/**
+ * Init the priority queue. O(n).
+ *
+ * @param maxSize The maximum size (number of items) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ */
+template <class T, class Pos>
+PairingHeapPQ<T, Pos>::PairingHeapPQ(Pos maxSize, bool growable)
+  : maxSize(0), size(0), growable(growable), root(nil), pool(maxSize) {
+  reserve(maxSize < nil ? maxSize : nil - 1);
+}
+
+template <class T, class Pos>
+PairingHeapPQ<T, Pos>::~PairingHeapPQ() { // O(size) <= O(n)
+  clear();
+}
+
+/**
+ * Meld two trees: the root with the greater priority becomes the first
+ * child of the other one. O(1).
+ *
+ * @param a The root of the first tree (without siblings), or nil.
+ * @param b The root of the second tree (without siblings), or nil.
+ * @return The root of the tree melded.
+ */
+template <class T, class Pos>
+Pos PairingHeapPQ<T, Pos>::meld(Pos a, Pos b) {
+  if (a == nil)
+    return b;
+  if (b == nil)
+    return a;
+  if (nodes[b].priority < nodes[a].priority)
+    std::swap(a, b);
+  nodes[b].sibling = nodes[a].child;
+  if (nodes[a].child != nil)
+    nodes[nodes[a].child].prev = b;
+  nodes[b].prev = a;
+  nodes[a].child = b;
+  return a;
+}
+
+/**
+ * Detach a node (with its sub-tree) from its parent. O(1).
+ *
+ * @param x The node, not the root.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::cut(Pos x) {
+  Pos p = nodes[x].prev;
+  if (nodes[p].child == x)
+    nodes[p].child = nodes[x].sibling;
+  else
+    nodes[p].sibling = nodes[x].sibling;
+  if (nodes[x].sibling != nil)
+    nodes[nodes[x].sibling].prev = p;
+  nodes[x].sibling = nodes[x].prev = nil;
+}
+
+/**
+ * Two-pass pairing of a list of siblings into a single tree. O(log(n)) amortized.
+ *
+ * The first pass melds the siblings in pairs, left to right, keeping the
+ * results in a stack (linked by the sibling field); the second pass melds
+ * the stack, so right to left.
+ *
+ * @param first The first sibling of the list, or nil.
+ * @return The root of the tree.
+ */
+template <class T, class Pos>
+Pos PairingHeapPQ<T, Pos>::combine(Pos first) {
+  Pos stack = nil;
+  while (first != nil) {
+    Pos a = first;
+    Pos b = nodes[a].sibling;
+    first = (b != nil) ? nodes[b].sibling : nil;
+    nodes[a].sibling = nodes[a].prev = nil;
+    if (b != nil)
+      nodes[b].sibling = nodes[b].prev = nil;
+    Pos m = meld(a, b);
+    nodes[m].sibling = stack;
+    stack = m;
+  }
+  Pos result = nil;
+  while (stack != nil) {
+    Pos m = stack;
+    stack = nodes[m].sibling;
+    nodes[m].sibling = nil;
+    result = meld(result, m);
+  }
+  return result;
+}
+
+/**
+ * Destroy an item already detached, and free its slot. O(1).
+ *
+ * @param slot The slot of the item in the pool.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::release(Pos slot) {
+  PriorityItem<T, Pos>* item = pool.at(slot);
+  item->~PriorityItem<T, Pos>();
+  pool.retire(item);
+  freeSlots.push_back(slot);
+  size--;
+}
+
+/**
+ * Check if the priority queue is empty. O(1).
+ *
+ * @return True only if the current size is zero.
+ */
+template <class T, class Pos>
+bool PairingHeapPQ<T, Pos>::isEmpty() {
+  return (size == 0);
+}
+
+/**
+ * Check if the priority queue id full. O(1).
+ *
+ * A growable queue is full only when it can't grow anymore.
+ *
+ * @return True only if the current size is the maximum size.
+ */
+template <class T, class Pos>
+bool PairingHeapPQ<T, Pos>::isFull() {
+  return (size == maxSize) && !(growable && maxSize < nil - 1);
+}
+
+/**
+ * Function for enlarge the queue, so it can store (n) items without allocating
+ * the items. O(n).
+ *
+ * It works also if the queue isn't growable; it never shrinks the queue.
+ *
+ * @param n The number of items, lesser than the maximum of Pos.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::reserve(Pos n) {
+  if (n <= maxSize || n == nil)
+    return; // nothing to do
+  pool.grow(n);
+  nodes.resize(n);
+  for (Pos s = n; s > maxSize; s--)
+    freeSlots.push_back(s-1); // the lower slots on the top
+  maxSize = n;
+}
+
+/**
+ * Double the capacity of a full growable queue. O(n), amortized O(1).
+ *
+ * @return False if the queue isn't growable or can't grow anymore.
+ */
+template <class T, class Pos>
+bool PairingHeapPQ<T, Pos>::grow() {
+  if (!growable || maxSize >= nil - 1)
+    return false;
+  if (maxSize > (nil - 1) / 2)
+    reserve(nil - 1);
+  else
+    reserve(maxSize > 0 ? 2*maxSize : 1);
+  return true;
+}
+
+/**
+ * Function for get the minimum value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Pos>
+T PairingHeapPQ<T, Pos>::min() {
+  return top();
+}
+
+/**
+ * Function for get a reference to the minimum value, without copying it. O(1).
+ *
+ * The reference is valid until the item is deleted; if the queue is empty,
+ * it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Pos>
+const T& PairingHeapPQ<T, Pos>::top() {
+  if (size > 0)
+    return pool.at(root)->item;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the minimum priority, without the value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Pos>
+py_t PairingHeapPQ<T, Pos>::minPriority() {
+  if (size > 0)
+    return nodes[root].priority;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for emplacing a new item. O(1).
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full.
+ */
+template <class T, class Pos>
+template <class... Args>
+typename PairingHeapPQ<T, Pos>::Handle
+PairingHeapPQ<T, Pos>::emplace(py_t priority, Args&&... args) {
+  if (size >= maxSize && !grow())
+    return nullptr; // if the queue if full, exit
+  Pos slot = freeSlots.back();
+  freeSlots.pop_back();
+  PriorityItem<T, Pos>* pi = new (pool.at(slot)) PriorityItem<T, Pos>(priority, slot, std::forward<Args>(args)...);
+  Node n = { priority, nil, nil, nil };
+  nodes[slot] = n;
+  root = meld(root, slot);
+  size++;
+  return Handle(pi, pool.generation(pi));
+}
+
+/**
+ * Check if the item of a handle is still in the queue. O(1).
+ *
+ * @param pi The handle of the item.
+ * @return False if the handle is null or the item was deleted.
+ */
+template <class T, class Pos>
+bool PairingHeapPQ<T, Pos>::contains(Handle pi) {
+  return pi && pool.generation(pi.get()) == pi.generation();
+}
+
+/**
+ * Function for decrease the priority of an item in the queue. o(log(n)) amortized.
+ *
+ * The sub-tree of the item is detached and melded with the root.
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::decrease(py_t newPriority, Handle pi) {
+  if (!contains(pi) || newPriority >= pi->priority)
+    return; // if the newPriority isn't lesser then the current priority, nothing to do
+  Pos x = pi->pos;
+  nodes[x].priority = pool.at(x)->priority = newPriority;
+  if (x != root) {
+    cut(x);
+    root = meld(root, x);
+  }
+}
+
+/**
+ * Function for increase the priority of an item in the queue. O(log(n)) amortized.
+ *
+ * The children of the item are paired and melded with the root, then the
+ * item, alone, is melded again.
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::increase(py_t newPriority, Handle pi) {
+  if (!contains(pi) || newPriority <= pi->priority)
+    return; // if the newPriority isn't greater then the current priority, nothing to do
+  Pos x = pi->pos;
+  Pos children = nodes[x].child;
+  nodes[x].child = nil;
+  if (x == root)
+    root = nil;
+  else
+    cut(x);
+  nodes[x].priority = pool.at(x)->priority = newPriority;
+  root = meld(meld(root, combine(children)), x);
+}
+
+/**
+ * Function for delete an item, anywhere in the queue. O(log(n)) amortized.
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue.
+ */
+template <class T, class Pos>
+bool PairingHeapPQ<T, Pos>::erase(Handle pi) {
+  if (!contains(pi))
+    return false; // already deleted
+  Pos x = pi->pos;
+  if (x == root)
+    root = combine(nodes[x].child);
+  else {
+    cut(x);
+    root = meld(root, combine(nodes[x].child));
+  }
+  release(x);
+  return true;
+}
+
+/**
+ * Function for delete the minimum priority item. O(log(n)) amortized.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::deleteMin() {
+  if (size <= 0)
+    return; // nothing to delete
+  Pos x = root;
+  root = combine(nodes[x].child);
+  release(x);
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(n)) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Pos>
+T PairingHeapPQ<T, Pos>::popMin() {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  T value(std::move(pool.at(root)->item));
+  deleteMin();
+  return value;
+}
+
+/**
+ * Function for moving all the items of another queue in this one. O(m).
+ *
+ * See merge(other, handles).
+ *
+ * @param other The queue emptied.
+ * @return The number of items moved.
+ */
+template <class T, class Pos>
+Pos PairingHeapPQ<T, Pos>::merge(PairingHeapPQ&& other) {
+  return merge(std::move(other), DiscardOutput());
+}
+
+/**
+ * Function for moving all the items of another queue in this one. O(m).
+ *
+ * If the pool of the other queue can follow this one (see ItemPool::adopt:
+ * queues with the same initial capacity, which never grew), this queue
+ * adopts the pool of the other one: the items
+ * aren't moved and their handles stay valid, only the links of the nodes
+ * are renumbered (one pass over the m nodes), then the two trees are
+ * melded in O(1). Otherwise the values are moved in this queue, one
+ * emplace each, and the old handles become stale.
+ *
+ * @param other The queue emptied.
+ * @param handles Where the pairs (old handle, new handle) of the items are written.
+ * @return The number of items moved; less than the size of the other
+ * queue only if this one can't store them all (the maximum of Pos minus one).
+ */
+template <class T, class Pos>
+template <class OutputIt>
+Pos PairingHeapPQ<T, Pos>::merge(PairingHeapPQ&& other, OutputIt handles) {
+  if (&other == this || other.size == 0)
+    return 0; // nothing to do
+  Pos count = other.size;
+  std::size_t base = pool.capacity(); // first slot of the other pool, if adopted
+  std::vector<Pos> stack(1, other.root);
+  
+  if (base + other.maxSize < nil && pool.adopt(other.pool)) {
+    nodes.resize(base + other.maxSize);
+    while (!stack.empty()) { // renumber the nodes of the other tree
+      Pos x = stack.back();
+      stack.pop_back();
+      Node n = other.nodes[x];
+      if (n.sibling != nil)
+        stack.push_back(n.sibling);
+      if (n.child != nil)
+        stack.push_back(n.child);
+      n.child = (n.child != nil) ? n.child + base : nil;
+      n.sibling = (n.sibling != nil) ? n.sibling + base : nil;
+      n.prev = (n.prev != nil) ? n.prev + base : nil;
+      nodes[x + base] = n;
+      PriorityItem<T, Pos>* pi = pool.at(x + base);
+      pi->pos = x + base;
+      Handle h(pi, pool.generation(pi));
+      *handles++ = std::make_pair(h, h);
+    }
+    for (std::size_t s = base; s-- > maxSize; )
+      freeSlots.push_back(s); // the slots of the last chunk over maxSize
+    for (std::size_t i = other.freeSlots.size(); i-- > 0; )
+      freeSlots.push_back(other.freeSlots[i] + base);
+    maxSize = base + other.maxSize;
+    size += count;
+    root = meld(root, other.root + base);
+    
+    Pos capacity = other.maxSize; // the other queue has a new pool, all free
+    other.maxSize = 0;
+    other.size = 0;
+    other.root = nil;
+    other.nodes.clear();
+    other.freeSlots.clear();
+    other.reserve(capacity);
+    return count;
+  }
+  
+  if (count > nil - 1 - size)
+    count = nil - 1 - size;
+  reserve(size + count);
+  if (count < other.size) { // no room for all: move the minimum ones
+    for (Pos j=0; j < count; j++) {
+      PriorityItem<T, Pos>* from = other.pool.at(other.root);
+      Handle old(from, other.pool.generation(from));
+      *handles++ = std::make_pair(old, emplace(from->priority, std::move(from->item)));
+      other.deleteMin();
+    }
+    return count;
+  }
+  while (!stack.empty()) { // move every node, in any order
+    Pos x = stack.back();
+    stack.pop_back();
+    if (other.nodes[x].sibling != nil)
+      stack.push_back(other.nodes[x].sibling);
+    if (other.nodes[x].child != nil)
+      stack.push_back(other.nodes[x].child);
+    PriorityItem<T, Pos>* from = other.pool.at(x);
+    Handle old(from, other.pool.generation(from));
+    *handles++ = std::make_pair(old, emplace(from->priority, std::move(from->item)));
+    other.release(x);
+  }
+  other.root = nil;
+  return count;
+}
+
+/**
+ * Function for delete all the items in the queue. O(n).
+ *
+ * The tree is visited with an explicit stack of siblings lists.
+ */
+template <class T, class Pos>
+void PairingHeapPQ<T, Pos>::clear() {
+  std::vector<Pos> stack;
+  if (root != nil)
+    stack.push_back(root);
+  while (!stack.empty()) {
+    Pos x = stack.back();
+    stack.pop_back();
+    if (nodes[x].sibling != nil)
+      stack.push_back(nodes[x].sibling);
+    if (nodes[x].child != nil)
+      stack.push_back(nodes[x].child);
+    release(x);
+  }
+  root = nil;
+}
+
+#endif
@@ -0,0 +1,463 @@
+/**
+ * @file RadixHeapPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Monotone priority queue implemented with a radix heap.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef RADIXHEAPPQ_CPP
+#define RADIXHEAPPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <stdexcept>
+
+/**
+ * Monotone priority queue, static dimension, implemented with a radix heap.
+ *
+ * The priorities must never be lesser than the last minimum deleted (as in
+ * Dijkstra's algorithm or in an event simulation): emplace and decrease
+ * refuse such a priority. The items are in buckets by the highest bit that
+ * differs from the last minimum; deleteMin empties the first bucket not
+ * empty into the lower ones, so an item is moved at most once for every
+ * bit of py_t. The buckets are scanned sequentially. Reading the minimum
+ * doesn't move the last minimum: if the first bucket is empty, the first
+ * one not empty is scanned, and the minimum found is kept until it leaves.
+ * The interface and the handles are the same of BinHeapPQ.
+ *
+ * |------------------------------|---------------------------|
+ * | Get min 		O(1)** 	  | Init 		O(n)  |
+ * | "Is empty?" 	O(1)	  | Destroy 		O(n)  |
+ * | Emplace new item 	O(1)      | Mem        		O(n)  |
+ * | De/In-crease key 	O(1)      | Erase item		O(1)  |
+ * | Delete min 	O(log(C))* |---------------------------|
+ * |------------------------------|  * amortized, C = max py_t
+ * ** O(k) for the k items of a bucket, when the minimum isn't known yet
+ */
+template <class T, class Pos = pos_t>
+class RadixHeapPQ {
+  static_assert(std::is_unsigned<Pos>::value, "the position type must be unsigned");
+public:
+  typedef Pos Size;				/**< Type of positions and sizes.      */
+  typedef ItemHandle<T, Pos> Handle;		/**< Checked read-only pointer to an item. */
+private:
+  static const unsigned buckets = std::numeric_limits<py_t>::digits + 1; /**< One for every bit, and the last minimum. */
+  static constexpr Pos nil = std::numeric_limits<Pos>::max(); /**< No slot. */
+  struct Entry {
+    py_t priority; /**< Copy of the priority of the item.  */
+    Pos slot;      /**< Slot of the item in the pool.      */
+  };
+  Pos maxSize;			/**< Max number of element stored.             */
+  Pos size;			/**< Current size (number of element).         */
+  bool growable;		/**< If the capacity grows when it's full.     */
+  py_t last;			/**< The last minimum deleted.                 */
+  Pos first;			/**< Slot of the minimum item (nil if not known). */
+  std::vector<Entry> bucket[buckets];	/**< Items, by highest different bit from last. */
+  std::vector<unsigned char> bucketOf;	/**< Bucket of every slot.              */
+  std::vector<Pos> index;		/**< Position in its bucket of every slot. */
+  std::vector<Pos> freeSlots;		/**< Stack of the free slots of the pool.  */
+  ItemPool<PriorityItem<T, Pos>, Pos> pool; /**< Slots of the items.      */
+  // private function for internal use
+  static unsigned bucketFor(py_t, py_t);
+  void insert(const Entry&);
+  void remove(Pos);
+  Pos findMin();
+  void pull();
+  bool grow();
+public:
+  RadixHeapPQ(Pos, bool = false);
+  ~RadixHeapPQ();
+  RadixHeapPQ(const RadixHeapPQ&) = delete;
+  RadixHeapPQ& operator=(const RadixHeapPQ&) = delete;
+  bool isEmpty();
+  bool isFull();
+  void reserve(Pos);
+  T min(); // throw an exception if heap is empty
+  const T& top(); // throw an exception if heap is empty
+  py_t minPriority(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(py_t, Args&&...);
+  bool contains(Handle);
+  bool decrease(py_t, Handle);
+  void increase(py_t, Handle);
+  bool erase(Handle);
+  void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+  void clear();
+};
+
+template <class T, class Pos>
+constexpr Pos RadixHeapPQ<T, Pos>::nil;
+
+/**
+ * Init the priority queue. O(n).
+ *
+ * @param maxSize The maximum size (number of items) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ */
+template <class T, class Pos>
+RadixHeapPQ<T, Pos>::RadixHeapPQ(Pos maxSize, bool growable)
+  : maxSize(0), size(0), growable(growable), last(0), first(nil), pool(maxSize) {
+  reserve(maxSize);
+}
+
+template <class T, class Pos>
+RadixHeapPQ<T, Pos>::~RadixHeapPQ() { // O(size) <= O(n)
+  clear();
+}
+
+/**
+ * Bucket of a priority: the position of the highest bit different from
+ * the last minimum, plus one (zero if they are equal). O(1).
+ *
+ * @param priority The priority, not lesser than last.
+ * @param last The last minimum.
+ * @return The bucket, in [0, buckets).
+ */
+template <class T, class Pos>
+unsigned RadixHeapPQ<T, Pos>::bucketFor(py_t priority, py_t last) {
+  unsigned long long x = priority ^ last;
+  if (x == 0)
+    return 0;
+#ifdef __GNUC__
+  return std::numeric_limits<unsigned long long>::digits - __builtin_clzll(x);
+#else
+  unsigned b = 0;
+  for (; x; x >>= 1)
+    b++;
+  return b;
+#endif
+}
+
+/**
+ * Append an item in its bucket. O(1) amortized.
+ *
+ * @param e The priority and the slot of the item.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::insert(const Entry& e) {
+  unsigned b = bucketFor(e.priority, last);
+  bucketOf[e.slot] = b;
+  index[e.slot] = bucket[b].size();
+  bucket[b].push_back(e);
+  if (first != nil && e.priority < pool.at(first)->priority)
+    first = e.slot; // the new minimum
+}
+
+/**
+ * Remove an item from its bucket, moving the last one of the bucket in its place. O(1).
+ *
+ * @param slot The slot of the item.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::remove(Pos slot) {
+  std::vector<Entry>& b = bucket[bucketOf[slot]];
+  Pos i = index[slot];
+  b[i] = b.back();
+  index[b[i].slot] = i;
+  b.pop_back();
+  if (slot == first)
+    first = nil;
+}
+
+/**
+ * Find the minimum item, without moving the last minimum. O(1) if already known.
+ *
+ * The items of the first bucket are all equal to the last minimum;
+ * otherwise the first bucket not empty is scanned (O(k) for k items).
+ * Working only if the queue isn't empty.
+ *
+ * @return The slot of the minimum item in the pool.
+ */
+template <class T, class Pos>
+Pos RadixHeapPQ<T, Pos>::findMin() {
+  if (first != nil)
+    return first;
+  unsigned b = 0;
+  while (bucket[b].empty())
+    b++;
+  const Entry* e = &bucket[b][0];
+  for (std::size_t i=1; i < bucket[b].size(); i++)
+    if (bucket[b][i].priority < e->priority)
+      e = &bucket[b][i];
+  first = e->slot;
+  return first;
+}
+
+/**
+ * Move the minimum items in the first bucket, before deleting one. O(log(C)) amortized.
+ *
+ * If the first bucket is empty, the minimum of the first one not empty
+ * (findMin) becomes the last minimum, and all its items are moved in
+ * lower buckets (they all differ from the new minimum in lower bits).
+ * Working only if the queue isn't empty.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::pull() {
+  if (!bucket[0].empty())
+    return; // nothing to do
+  last = pool.at(findMin())->priority;
+  unsigned b = 1;
+  while (bucket[b].empty())
+    b++;
+  std::vector<Entry> moving;
+  moving.swap(bucket[b]);
+  for (std::size_t i=0; i < moving.size(); i++)
+    insert(moving[i]);
+  moving.clear();
+  bucket[b].swap(moving); // keep the memory of the bucket
+}
+
+/**
+ * Check if the priority queue is empty. O(1).
+ *
+ * @return True only if the current size is zero.
+ */
+template <class T, class Pos>
+bool RadixHeapPQ<T, Pos>::isEmpty() {
+  return (size == 0);
+}
+
+/**
+ * Check if the priority queue id full. O(1).
+ *
+ * A growable queue is full only when it can't grow anymore.
+ *
+ * @return True only if the current size is the maximum size.
+ */
+template <class T, class Pos>
+bool RadixHeapPQ<T, Pos>::isFull() {
+  return (size == maxSize) && !(growable && maxSize < std::numeric_limits<Pos>::max());
+}
+
+/**
+ * Function for enlarge the queue, so it can store (n) items without allocating
+ * the items. O(n).
+ *
+ * It works also if the queue isn't growable; it never shrinks the queue.
+ *
+ * @param n The number of items.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::reserve(Pos n) {
+  if (n <= maxSize)
+    return; // nothing to do
+  pool.grow(n);
+  bucketOf.resize(n);
+  index.resize(n);
+  for (Pos s = n; s > maxSize; s--)
+    freeSlots.push_back(s-1); // the lower slots on the top
+  maxSize = n;
+}
+
+/**
+ * Double the capacity of a full growable queue. O(n), amortized O(1).
+ *
+ * @return False if the queue isn't growable or can't grow anymore.
+ */
+template <class T, class Pos>
+bool RadixHeapPQ<T, Pos>::grow() {
+  if (!growable || maxSize == std::numeric_limits<Pos>::max())
+    return false;
+  if (maxSize > std::numeric_limits<Pos>::max() / 2)
+    reserve(std::numeric_limits<Pos>::max());
+  else
+    reserve(maxSize > 0 ? 2*maxSize : 1);
+  return true;
+}
+
+/**
+ * Function for get the minimum value. O(1) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Pos>
+T RadixHeapPQ<T, Pos>::min() {
+  return top();
+}
+
+/**
+ * Function for get a reference to the minimum value, without copying it. O(1) amortized.
+ *
+ * The reference is valid until the item is deleted; if the queue is empty,
+ * it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Pos>
+const T& RadixHeapPQ<T, Pos>::top() {
+  if (size > 0)
+    return pool.at(findMin())->item;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the minimum priority, without the value. O(1) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Pos>
+py_t RadixHeapPQ<T, Pos>::minPriority() {
+  if (size > 0)
+    return pool.at(findMin())->priority;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for emplacing a new item. O(1).
+ *
+ * @param priority The priority of the new item, not lesser than the last minimum deleted.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full
+ * or the priority is lesser than the last minimum.
+ */
+template <class T, class Pos>
+template <class... Args>
+typename RadixHeapPQ<T, Pos>::Handle
+RadixHeapPQ<T, Pos>::emplace(py_t priority, Args&&... args) {
+  if (priority < last || (size >= maxSize && !grow()))
+    return nullptr; // if the queue if full (or the priority is too low), exit
+  Pos slot = freeSlots.back();
+  freeSlots.pop_back();
+  PriorityItem<T, Pos>* pi = new (pool.at(slot)) PriorityItem<T, Pos>(priority, slot, std::forward<Args>(args)...);
+  Entry e = { priority, slot };
+  insert(e);
+  size++;
+  return Handle(pi, pool.generation(pi));
+}
+
+/**
+ * Check if the item of a handle is still in the queue. O(1).
+ *
+ * @param pi The handle of the item.
+ * @return False if the handle is null or the item was deleted.
+ */
+template <class T, class Pos>
+bool RadixHeapPQ<T, Pos>::contains(Handle pi) {
+  return pi && pool.generation(pi.get()) == pi.generation();
+}
+
+/**
+ * Function for decrease the priority of an item in the queue. O(1).
+ *
+ * The new priority can't be lesser than the last minimum deleted.
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ * @return False (and the item isn't changed) if the new priority is lesser than the last minimum.
+ */
+template <class T, class Pos>
+bool RadixHeapPQ<T, Pos>::decrease(py_t newPriority, Handle pi) {
+  if (!contains(pi) || newPriority >= pi->priority)
+    return true; // if the newPriority isn't lesser then the current priority, nothing to do
+  if (newPriority < last)
+    return false; // before the last minimum
+  Pos slot = pi->pos;
+  remove(slot);
+  pool.at(slot)->priority = newPriority;
+  Entry e = { newPriority, slot };
+  insert(e);
+  return true;
+}
+
+/**
+ * Function for increase the priority of an item in the queue. O(1).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::increase(py_t newPriority, Handle pi) {
+  if (!contains(pi) || newPriority <= pi->priority)
+    return; // if the newPriority isn't greater then the current priority, nothing to do
+  Pos slot = pi->pos;
+  remove(slot);
+  pool.at(slot)->priority = newPriority;
+  Entry e = { newPriority, slot };
+  insert(e);
+}
+
+/**
+ * Function for delete an item, anywhere in the queue. O(1).
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue.
+ */
+template <class T, class Pos>
+bool RadixHeapPQ<T, Pos>::erase(Handle pi) {
+  if (!contains(pi))
+    return false; // already deleted
+  Pos slot = pi->pos;
+  remove(slot);
+  PriorityItem<T, Pos>* item = pool.at(slot);
+  item->~PriorityItem<T, Pos>();
+  pool.retire(item);
+  freeSlots.push_back(slot);
+  size--;
+  return true;
+}
+
+/**
+ * Function for delete the minimum priority item. O(log(C)) amortized.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::deleteMin() {
+  if (size <= 0)
+    return; // nothing to delete
+  pull();
+  Pos slot = findMin(); // the one of top(), in the first bucket
+  remove(slot);
+  PriorityItem<T, Pos>* item = pool.at(slot);
+  item->~PriorityItem<T, Pos>();
+  pool.retire(item);
+  freeSlots.push_back(slot);
+  size--;
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(log(C)) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Pos>
+T RadixHeapPQ<T, Pos>::popMin() {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  T value(std::move(pool.at(findMin())->item));
+  deleteMin();
+  return value;
+}
+
+/**
+ * Function for delete all the items in the queue. O(n).
+ *
+ * The last minimum is reset, so any priority can be emplaced again.
+ */
+template <class T, class Pos>
+void RadixHeapPQ<T, Pos>::clear() {
+  for (unsigned b=0; b < buckets; b++) {
+    for (std::size_t i=0; i < bucket[b].size(); i++) {
+      PriorityItem<T, Pos>* item = pool.at(bucket[b][i].slot);
+      item->~PriorityItem<T, Pos>();
+      pool.retire(item);
+      freeSlots.push_back(bucket[b][i].slot);
+    }
+    bucket[b].clear();
+  }
+  size = 0;
+  last = 0;
+  first = nil;
+}
+
+#endif
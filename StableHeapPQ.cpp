@@ -0,0 +1,345 @@
+/**
+ * @file StableHeapPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Stable priority queue: a BinHeapPQ where the items with the same
+ * priority are deleted in order of insertion (FIFO).
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef STABLEHEAPPQ_CPP
+#define STABLEHEAPPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <cstdint>
+#include <utility>
+
+/**
+ * Priority with the sequence number of its insertion.
+ *
+ * It's stored in the heap array in place of the priority (next to it,
+ * with InlineLayout), and it converts to the priority.
+ */
+template <class Key>
+struct Stamped {
+  Key key;		/**< The priority.                        */
+  std::uint64_t seq;	/**< The number of items inserted before. */
+  operator const Key&() const { return key; }
+};
+
+/**
+ * Lexicographic compare of (key, seq), with the comparator of the keys.
+ *
+ * Mode 2: unsigned keys of up to 64 bits, by std::less or std::greater,
+ * are packed with the sequence number in 128 bits and compared once;
+ * mode 1: arithmetic keys, the two compares combined without branches;
+ * mode 0: any other key.
+ */
+template <class Key, class Compare>
+struct StampTraits {
+#ifdef __SIZEOF_INT128__
+  static constexpr bool packed = std::is_unsigned<Key>::value && sizeof(Key) <= 8;
+#else
+  static constexpr bool packed = false;
+#endif
+  static constexpr int mode = !KeyTraits<Key, Compare>::branchless ? 0 : packed ? 2 : 1;
+};
+
+template <class Key, class Compare, int = StampTraits<Key, Compare>::mode>
+struct StampOrder {
+  static bool less(const Compare& less, const Stamped<Key>& a, const Stamped<Key>& b) {
+    return less(a.key, b.key) || (!less(b.key, a.key) && a.seq < b.seq);
+  }
+};
+
+template <class Key, class Compare>
+struct StampOrder<Key, Compare, 1> {
+  static bool less(const Compare& less, const Stamped<Key>& a, const Stamped<Key>& b) {
+    return less(a.key, b.key) | (!less(b.key, a.key) & (a.seq < b.seq));
+  }
+};
+
+#ifdef __SIZEOF_INT128__
+template <class Key, class Compare>
+struct StampOrder<Key, Compare, 2> {
+  __extension__ typedef unsigned __int128 Wide;
+  static Wide pack(const Stamped<Key>& a) { // std::greater: the complement of the key
+    Key key = std::is_same<Compare, std::greater<Key> >::value ? Key(~a.key) : a.key;
+    return Wide(key) << 64 | a.seq;
+  }
+  static bool less(const Compare&, const Stamped<Key>& a, const Stamped<Key>& b) {
+    return pack(a) < pack(b);
+  }
+};
+#endif
+
+/**
+ * Order of the stamped priorities: by priority, then by sequence number.
+ */
+template <class Compare>
+class StableCompare : private KeyCompare<Compare> {
+public:
+  StableCompare(const Compare& compare) : KeyCompare<Compare>(compare) {}
+  using KeyCompare<Compare>::compare;
+  template <class Key>
+  bool operator()(const Stamped<Key>& a, const Stamped<Key>& b) const {
+    return StampOrder<Key, Compare>::less(this->compare(), a, b);
+  }
+};
+
+/**
+ * The stamped priorities are selected as their keys: copied, without branches.
+ */
+template <class Key, class Compare>
+struct KeyTraits<Stamped<Key>, StableCompare<Compare> > {
+  static constexpr bool branchless = KeyTraits<Key, Compare>::branchless;
+  static constexpr bool vectorized = false;
+};
+
+/**
+ * Input iterator of pairs (priority, value) which stamps the priorities,
+ * for the batch functions of BinHeapPQ.
+ */
+template <class InputIt, class Key>
+class StampIterator {
+private:
+  struct Stamp {
+    Stamped<Key> first;
+    decltype(((*std::declval<InputIt&>()).second)) second; // a reference to the value
+    const Stamp* operator->() const { return this; }
+  };
+  InputIt it;		/**< The pair (priority, value).           */
+  std::uint64_t seq;	/**< The sequence number of the pair.      */
+public:
+  StampIterator(InputIt it, std::uint64_t seq) : it(it), seq(seq) {}
+  Stamp operator->() const { return Stamp{Stamped<Key>{(*it).first, seq}, (*it).second}; }
+  StampIterator& operator++() { ++it; seq++; return *this; }
+  bool operator!=(const StampIterator& other) const { return it != other.it; }
+};
+
+/**
+ * Stable priority queue, a BinHeapPQ(see BinHeapPQ.cpp) of stamped priorities.
+ *
+ * Every item takes the next sequence number (64 bits, it doesn't wrap)
+ * when it's inserted, and the items with the same priority are deleted
+ * in order of sequence number; decrease and increase keep it.
+ * The priorities of the handles are Stamped, they convert to Key.
+ */
+template <class T, class Layout = PointerLayout, unsigned Arity = 2, class Pos = pos_t,
+          class Key = py_t, class Compare = std::less<Key>, class Stats = NoStats>
+class StableHeapPQ : public BinHeapPQ<T, Layout, Arity, Pos, Stamped<Key>, StableCompare<Compare>, Stats> {
+private:
+  typedef BinHeapPQ<T, Layout, Arity, Pos, Stamped<Key>, StableCompare<Compare>, Stats> Base;
+  std::uint64_t seq;	/**< The sequence number of the next item. */
+public:
+  typedef typename Base::Size Size;
+  typedef typename Base::Handle Handle;
+  typedef Key Priority;
+  typedef Compare Comparator;
+  StableHeapPQ(Pos, bool = false, const Compare& = Compare());
+  const Key& minPriority(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(const Key&, Args&&...);
+  template <class... Args>
+  Handle replaceMin(const Key&, Args&&...); // throw an exception if heap is empty
+  template <class... Args>
+  T pushPop(const Key&, Args&&...);
+  void decrease(const Key&, Handle);
+  void increase(const Key&, Handle);
+  template <class InputIt>
+  Pos assign(InputIt, InputIt);
+  template <class InputIt, class OutputIt>
+  Pos assign(InputIt, InputIt, OutputIt);
+  template <class InputIt>
+  Pos emplaceBatch(InputIt, InputIt);
+  Pos merge(StableHeapPQ&&);
+  template <class OutputIt>
+  Pos merge(StableHeapPQ&&, OutputIt);
+  const Compare& comparator() const { return Base::comparator().compare(); }
+};
+
+/**
+ * Init the priority queue. O(n).
+ *
+ * @param maxSize The maximum size (number of items) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ * @param compare The comparator of the priorities.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::StableHeapPQ(Pos maxSize, bool growable, const Compare& compare)
+  : Base(maxSize, growable, StableCompare<Compare>(compare)) {
+  seq = 0;
+}
+
+/**
+ * Function for get the minimum priority, without the value. O(1).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+const Key& StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::minPriority() {
+  return Base::minPriority().key;
+}
+
+/**
+ * Function for emplacing a new item, after the ones with the same priority. O(log(n)).
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::emplace(const Key& priority, Args&&... args) {
+  Handle h = Base::emplace(Stamped<Key>{priority, seq}, std::forward<Args>(args)...);
+  if (h)
+    seq++;
+  return h;
+}
+
+/**
+ * Function for replacing the minimum item with a new one, after the ones with the same priority. O(log(n)).
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::replaceMin(const Key& priority, Args&&... args) {
+  Handle h = Base::replaceMin(Stamped<Key>{priority, seq}, std::forward<Args>(args)...);
+  seq++;
+  return h;
+}
+
+/**
+ * Function for emplacing a new item, after the ones with the same priority,
+ * and deleting the minimum. O(log(n)).
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return The value associated to the minimum priority, the new one or the old one.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+T StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::pushPop(const Key& priority, Args&&... args) {
+  return Base::pushPop(Stamped<Key>{priority, seq++}, std::forward<Args>(args)...);
+}
+
+/**
+ * Function for decrease the priority of an item in the queue. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::decrease(const Key& newPriority, Handle pi) {
+  if (this->contains(pi))
+    Base::decrease(Stamped<Key>{newPriority, pi->priority.seq}, pi);
+}
+
+/**
+ * Function for increase the priority of an item in the queue. O(log(n)).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+void StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::increase(const Key& newPriority, Handle pi) {
+  if (this->contains(pi))
+    Base::increase(Stamped<Key>{newPriority, pi->priority.seq}, pi);
+}
+
+/**
+ * Function for replacing the content of the queue with a range of items. O(n).
+ *
+ * The items are stamped in the order of the range.
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<Key, T>.
+ * @param last The end of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class InputIt>
+Pos StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::assign(InputIt first, InputIt last) {
+  Pos count = Base::assign(StampIterator<InputIt, Key>(first, seq), StampIterator<InputIt, Key>(last, seq));
+  seq += count;
+  return count;
+}
+
+/**
+ * Function for replacing the content of the queue with a range of items,
+ * without losing the control handles. O(n).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<Key, T>.
+ * @param last The end of the range.
+ * @param handles Where the handles are written, in the order of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class InputIt, class OutputIt>
+Pos StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::assign(InputIt first, InputIt last, OutputIt handles) {
+  Pos count = Base::assign(StampIterator<InputIt, Key>(first, seq), StampIterator<InputIt, Key>(last, seq), handles);
+  seq += count;
+  return count;
+}
+
+/**
+ * Function for emplacing a batch of new items. O(m*log(n)) or O(m + log(n)^2).
+ *
+ * @param first The begin of a range of pairs (priority, value), like std::pair<Key, T>.
+ * @param last The end of the range.
+ * @return The number of items stored; the items after maxSize are ignored (if not growable).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class InputIt>
+Pos StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::emplaceBatch(InputIt first, InputIt last) {
+  Pos count = Base::emplaceBatch(StampIterator<InputIt, Key>(first, seq), StampIterator<InputIt, Key>(last, seq));
+  seq += count;
+  return count;
+}
+
+/**
+ * Function for moving all the items of another queue in this one. O(n+m).
+ *
+ * The items keep their sequence numbers: the ones of each queue stay in
+ * order, and the next ones are inserted after all of them.
+ *
+ * @param other The queue emptied.
+ * @return The number of items moved.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+Pos StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::merge(StableHeapPQ&& other) {
+  if (other.seq > seq)
+    seq = other.seq;
+  return Base::merge(std::move(other));
+}
+
+/**
+ * Function for moving all the items of another queue in this one,
+ * with the new handles of the items moved. O(n+m).
+ *
+ * @param other The queue emptied.
+ * @param handles Where the pairs (old handle, new handle) are written.
+ * @return The number of items moved.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class OutputIt>
+Pos StableHeapPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::merge(StableHeapPQ&& other, OutputIt handles) {
+  if (other.seq > seq)
+    seq = other.seq;
+  return Base::merge(std::move(other), handles);
+}
+
+#endif
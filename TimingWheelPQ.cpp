@@ -0,0 +1,561 @@
+/**
+ * @file TimingWheelPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Monotone priority queue implemented with a hierarchical timing wheel.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef TIMINGWHEELPQ_CPP
+#define TIMINGWHEELPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <stdexcept>
+#include <stdint.h>
+
+/**
+ * Monotone priority queue for timers, implemented with a hierarchical timing wheel.
+ *
+ * The priorities are times: they must never be lesser than the current
+ * time of the queue (the last minimum deleted, or the time of advanceTo),
+ * so emplace and decrease refuse such a time; reading the minimum doesn't
+ * move the clock. Every wheel has 64 slots,
+ * one for every digit (6 bits) of the time; an item is in the wheel of the
+ * highest digit that differs from the current time, in a doubly linked list.
+ * Emplace, cancel (erase) and de/in-crease are O(1); when the current time
+ * reaches a slot of an higher wheel, its items cascade in the lower ones,
+ * so an item is moved at most once for every wheel. If the first wheel is
+ * empty, the minimum is found scanning the first slot not empty of the
+ * lowest wheel, and it's kept until it leaves the queue.
+ * advanceTo(time) deletes all the due items in one pass, in order of time.
+ * The interface and the handles are the same of BinHeapPQ; the capacity is
+ * limited to the maximum of Pos minus one.
+ *
+ * |------------------------------|---------------------------|
+ * | Get min 		O(1)** 	  | Init 		O(n)  |
+ * | "Is empty?" 	O(1)	  | Destroy 		O(n)  |
+ * | Emplace new item 	O(1)      | Mem        		O(n)  |
+ * | De/In-crease key 	O(1)      | Erase item		O(1)  |
+ * | Delete min 	O(1)*     | Advance (k due)	O(k)* |
+ * |------------------------------|---------------------------|
+ * * amortized over the cascades, at most one for every wheel
+ * ** O(k) for the k items of a slot, when the minimum isn't known yet
+ */
+template <class T, class Pos = pos_t>
+class TimingWheelPQ {
+  static_assert(std::is_unsigned<Pos>::value, "the position type must be unsigned");
+public:
+  typedef Pos Size;				/**< Type of positions and sizes.      */
+  typedef ItemHandle<T, Pos> Handle;		/**< Checked read-only pointer to an item. */
+private:
+  static const unsigned bits = 6;	/**< Bits of a digit of the time.  */
+  static const unsigned slots = 1u << bits; /**< Slots of every wheel.  */
+  static const unsigned wheels = (std::numeric_limits<py_t>::digits + bits - 1) / bits; /**< Number of wheels. */
+  static constexpr Pos nil = std::numeric_limits<Pos>::max(); /**< End of a list. */
+  Pos maxSize;			/**< Max number of element stored.             */
+  Pos size;			/**< Current size (number of element).         */
+  bool growable;		/**< If the capacity grows when it's full.     */
+  py_t current;			/**< The current time.                         */
+  Pos first;			/**< Slot of the minimum item (nil if not known). */
+  uint64_t occupied[wheels];	/**< Bitmap of the slots not empty, every wheel. */
+  Pos head[wheels * slots];	/**< First item of every slot (nil if empty).  */
+  std::vector<Pos> next;	/**< Next item in the slot, for every item.     */
+  std::vector<Pos> prev;	/**< Previous item in the slot (nil if first).  */
+  std::vector<unsigned short> where; /**< Slot (wheel*slots + digit) of every item. */
+  std::vector<Pos> freeSlots;	/**< Stack of the free slots of the pool.       */
+  ItemPool<PriorityItem<T, Pos>, Pos> pool; /**< Slots of the items.      */
+  // private function for internal use
+  static unsigned lowest(uint64_t);
+  static unsigned highest(uint64_t);
+  unsigned slotFor(py_t) const;
+  void link(Pos);
+  void unlink(Pos);
+  void release(Pos);
+  Pos findMin();
+  void advance(py_t);
+  bool grow();
+public:
+  TimingWheelPQ(Pos, bool = false);
+  ~TimingWheelPQ();
+  TimingWheelPQ(const TimingWheelPQ&) = delete;
+  TimingWheelPQ& operator=(const TimingWheelPQ&) = delete;
+  bool isEmpty();
+  bool isFull();
+  void reserve(Pos);
+  py_t time() const { return current; }
+  T min(); // throw an exception if heap is empty
+  const T& top(); // throw an exception if heap is empty
+  py_t minPriority(); // throw an exception if heap is empty
+  template <class... Args>
+  Handle emplace(py_t, Args&&...);
+  bool contains(Handle);
+  bool decrease(py_t, Handle);
+  void increase(py_t, Handle);
+  bool erase(Handle);
+  void deleteMin();
+  T popMin(); // throw an exception if heap is empty
+  template <class OutputIt>
+  Pos advanceTo(py_t, OutputIt);
+  void clear();
+};
+
+template <class T, class Pos>
+constexpr Pos TimingWheelPQ<T, Pos>::nil;
+
+/**
+ * Init the priority queue, at time zero. O(n).
+ *
+ * @param maxSize The maximum size (number of items) you want to, or the initial one.
+ * @param growable If the queue can grow over maxSize.
+ */
+template <class T, class Pos>
+TimingWheelPQ<T, Pos>::TimingWheelPQ(Pos maxSize, bool growable)
+  : maxSize(0), size(0), growable(growable), current(0), first(nil), pool(maxSize) {
+  std::fill(occupied, occupied + wheels, 0);
+  std::fill(head, head + wheels * slots, nil);
+  reserve(maxSize < nil ? maxSize : nil - 1);
+}
+
+template <class T, class Pos>
+TimingWheelPQ<T, Pos>::~TimingWheelPQ() { // O(size) <= O(n)
+  clear();
+}
+
+/**
+ * Position of the lowest bit set. O(1).
+ *
+ * @param mask A mask not zero.
+ * @return The position, from zero.
+ */
+template <class T, class Pos>
+unsigned TimingWheelPQ<T, Pos>::lowest(uint64_t mask) {
+#ifdef __GNUC__
+  return __builtin_ctzll(mask);
+#else
+  unsigned b = 0;
+  for (; !(mask & 1); mask >>= 1)
+    b++;
+  return b;
+#endif
+}
+
+/**
+ * Position of the highest bit set. O(1).
+ *
+ * @param mask A mask not zero.
+ * @return The position, from zero.
+ */
+template <class T, class Pos>
+unsigned TimingWheelPQ<T, Pos>::highest(uint64_t mask) {
+#ifdef __GNUC__
+  return 63 - __builtin_clzll(mask);
+#else
+  unsigned b = 0;
+  for (; mask >>= 1; )
+    b++;
+  return b;
+#endif
+}
+
+/**
+ * Slot of a time: the wheel of the highest digit different from the
+ * current time, and the digit of the time in that wheel. O(1).
+ *
+ * @param priority The time, not lesser than the current one.
+ * @return The slot, wheel*slots + digit.
+ */
+template <class T, class Pos>
+unsigned TimingWheelPQ<T, Pos>::slotFor(py_t priority) const {
+  py_t x = priority ^ current;
+  unsigned w = x ? highest(x) / bits : 0;
+  return w * slots + ((priority >> (w * bits)) & (slots - 1));
+}
+
+/**
+ * Insert an item at the head of its slot. O(1).
+ *
+ * @param slot The slot of the item in the pool.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::link(Pos slot) {
+  unsigned s = slotFor(pool.at(slot)->priority);
+  where[slot] = s;
+  prev[slot] = nil;
+  next[slot] = head[s];
+  if (head[s] != nil)
+    prev[head[s]] = slot;
+  head[s] = slot;
+  occupied[s / slots] |= uint64_t(1) << (s % slots);
+  if (first != nil && pool.at(slot)->priority < pool.at(first)->priority)
+    first = slot; // the new minimum
+}
+
+/**
+ * Remove an item from its slot. O(1).
+ *
+ * @param slot The slot of the item in the pool.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::unlink(Pos slot) {
+  unsigned s = where[slot];
+  if (prev[slot] != nil)
+    next[prev[slot]] = next[slot];
+  else
+    head[s] = next[slot];
+  if (next[slot] != nil)
+    prev[next[slot]] = prev[slot];
+  if (head[s] == nil)
+    occupied[s / slots] &= ~(uint64_t(1) << (s % slots));
+  if (slot == first)
+    first = nil;
+}
+
+/**
+ * Destroy an item already unlinked, and free its slot. O(1).
+ *
+ * @param slot The slot of the item in the pool.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::release(Pos slot) {
+  PriorityItem<T, Pos>* item = pool.at(slot);
+  item->~PriorityItem<T, Pos>();
+  pool.retire(item);
+  freeSlots.push_back(slot);
+  size--;
+  if (slot == first)
+    first = nil;
+}
+
+/**
+ * Find the minimum item, without moving the clock. O(1) if already known.
+ *
+ * The minimum is the first item of the first wheel not empty, in its first
+ * slot not empty: every item of the first wheel in a slot has the same
+ * time, in an higher wheel the slot is scanned (O(k) for k items).
+ * Working only if the queue isn't empty.
+ *
+ * @return The slot of the minimum item in the pool.
+ */
+template <class T, class Pos>
+Pos TimingWheelPQ<T, Pos>::findMin() {
+  if (first != nil)
+    return first;
+  unsigned w = 0;
+  while (!occupied[w])
+    w++;
+  first = head[w * slots + lowest(occupied[w])];
+  if (w > 0)
+    for (Pos i = next[first]; i != nil; i = next[i])
+      if (pool.at(i)->priority < pool.at(first)->priority)
+        first = i;
+  return first;
+}
+
+/**
+ * Move the clock forward, cascading the items which aren't in the right
+ * wheel anymore. O(1) amortized.
+ *
+ * Only the slot of the new time in the wheel of the highest digit that
+ * changes can hold such items (the slots before it would be past times):
+ * they are linked again, in lower wheels.
+ *
+ * @param time The new current time; no item can be before it.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::advance(py_t time) {
+  py_t x = time ^ current;
+  current = time;
+  if (x >> bits == 0)
+    return; // the first wheel is always right
+  unsigned w = highest(x) / bits;
+  unsigned s = w * slots + ((time >> (w * bits)) & (slots - 1));
+  Pos list = head[s];
+  head[s] = nil;
+  occupied[w] &= ~(uint64_t(1) << (s % slots));
+  while (list != nil) {
+    Pos i = list;
+    list = next[i];
+    link(i);
+  }
+}
+
+/**
+ * Check if the priority queue is empty. O(1).
+ *
+ * @return True only if the current size is zero.
+ */
+template <class T, class Pos>
+bool TimingWheelPQ<T, Pos>::isEmpty() {
+  return (size == 0);
+}
+
+/**
+ * Check if the priority queue id full. O(1).
+ *
+ * A growable queue is full only when it can't grow anymore.
+ *
+ * @return True only if the current size is the maximum size.
+ */
+template <class T, class Pos>
+bool TimingWheelPQ<T, Pos>::isFull() {
+  return (size == maxSize) && !(growable && maxSize < nil - 1);
+}
+
+/**
+ * Function for enlarge the queue, so it can store (n) items without allocating
+ * the items. O(n).
+ *
+ * It works also if the queue isn't growable; it never shrinks the queue.
+ *
+ * @param n The number of items, lesser than the maximum of Pos.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::reserve(Pos n) {
+  if (n <= maxSize || n == nil)
+    return; // nothing to do
+  pool.grow(n);
+  next.resize(n);
+  prev.resize(n);
+  where.resize(n);
+  for (Pos s = n; s > maxSize; s--)
+    freeSlots.push_back(s-1); // the lower slots on the top
+  maxSize = n;
+}
+
+/**
+ * Double the capacity of a full growable queue. O(n), amortized O(1).
+ *
+ * @return False if the queue isn't growable or can't grow anymore.
+ */
+template <class T, class Pos>
+bool TimingWheelPQ<T, Pos>::grow() {
+  if (!growable || maxSize >= nil - 1)
+    return false;
+  if (maxSize > (nil - 1) / 2)
+    reserve(nil - 1);
+  else
+    reserve(maxSize > 0 ? 2*maxSize : 1);
+  return true;
+}
+
+/**
+ * Function for get the minimum value. O(1) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The (copy) value associated.
+ */
+template <class T, class Pos>
+T TimingWheelPQ<T, Pos>::min() {
+  return top();
+}
+
+/**
+ * Function for get a reference to the minimum value, without copying it. O(1) amortized.
+ *
+ * The reference is valid until the item is deleted; if the queue is empty,
+ * it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Pos>
+const T& TimingWheelPQ<T, Pos>::top() {
+  if (size > 0)
+    return pool.at(findMin())->item;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for get the minimum priority, without the value. O(1) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The priority of the minimum item.
+ */
+template <class T, class Pos>
+py_t TimingWheelPQ<T, Pos>::minPriority() {
+  if (size > 0)
+    return pool.at(findMin())->priority;
+  throw std::out_of_range("Empty priority queue!");
+}
+
+/**
+ * Function for emplacing a new item. O(1).
+ *
+ * @param priority The time of the new item, not lesser than the current time.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item created; null if the queue is full
+ * or the time is already passed.
+ */
+template <class T, class Pos>
+template <class... Args>
+typename TimingWheelPQ<T, Pos>::Handle
+TimingWheelPQ<T, Pos>::emplace(py_t priority, Args&&... args) {
+  if (priority < current || (size >= maxSize && !grow()))
+    return nullptr; // if the queue if full (or the time is passed), exit
+  Pos slot = freeSlots.back();
+  freeSlots.pop_back();
+  PriorityItem<T, Pos>* pi = new (pool.at(slot)) PriorityItem<T, Pos>(priority, slot, std::forward<Args>(args)...);
+  link(slot);
+  size++;
+  return Handle(pi, pool.generation(pi));
+}
+
+/**
+ * Check if the item of a handle is still in the queue. O(1).
+ *
+ * @param pi The handle of the item.
+ * @return False if the handle is null or the item was deleted.
+ */
+template <class T, class Pos>
+bool TimingWheelPQ<T, Pos>::contains(Handle pi) {
+  return pi && pool.generation(pi.get()) == pi.generation();
+}
+
+/**
+ * Function for decrease the priority (time) of an item in the queue. O(1).
+ *
+ * The new time can't be lesser than the current time.
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ * @return False (and the item isn't changed) if the new time is already passed.
+ */
+template <class T, class Pos>
+bool TimingWheelPQ<T, Pos>::decrease(py_t newPriority, Handle pi) {
+  if (!contains(pi) || newPriority >= pi->priority)
+    return true; // if the newPriority isn't lesser then the current priority, nothing to do
+  if (newPriority < current)
+    return false; // before the current time
+  Pos slot = pi->pos;
+  unlink(slot);
+  pool.at(slot)->priority = newPriority;
+  link(slot);
+  return true;
+}
+
+/**
+ * Function for increase the priority (time) of an item in the queue. O(1).
+ *
+ * @param newPriority The new priority value of the item.
+ * @param pi The handle of the item you want to modify; ignored if stale.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::increase(py_t newPriority, Handle pi) {
+  if (!contains(pi) || newPriority <= pi->priority)
+    return; // if the newPriority isn't greater then the current priority, nothing to do
+  Pos slot = pi->pos;
+  unlink(slot);
+  pool.at(slot)->priority = newPriority;
+  link(slot);
+}
+
+/**
+ * Function for delete (cancel) an item, anywhere in the queue. O(1).
+ *
+ * @param pi The handle of the item you want to delete; ignored if stale.
+ * @return False if the item wasn't in the queue.
+ */
+template <class T, class Pos>
+bool TimingWheelPQ<T, Pos>::erase(Handle pi) {
+  if (!contains(pi))
+    return false; // already deleted
+  unlink(pi->pos);
+  release(pi->pos);
+  return true;
+}
+
+/**
+ * Function for delete the minimum priority item. O(1) amortized.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::deleteMin() {
+  if (size <= 0)
+    return; // nothing to delete
+  Pos slot = findMin();
+  advance(pool.at(slot)->priority);
+  unlink(slot);
+  release(slot);
+}
+
+/**
+ * Function for delete the minimum priority item, moving its value out. O(1) amortized.
+ *
+ * If the queue is empty, it will raise an exception.
+ *
+ * @return The value associated to the minimum priority.
+ */
+template <class T, class Pos>
+T TimingWheelPQ<T, Pos>::popMin() {
+  if (size == 0)
+    throw std::out_of_range("Empty priority queue!");
+  T value(std::move(pool.at(findMin())->item));
+  deleteMin();
+  return value;
+}
+
+/**
+ * Function for delete all the items due at a time, moving their values out. O(k) amortized.
+ *
+ * The slots of the first wheel are emptied one after another, cascading
+ * the higher wheels when needed; the items of a slot have all the same time.
+ * Then the clock is moved to (time), also if no item was due, so a time
+ * before it can't be emplaced anymore.
+ *
+ * @param time The time reached: the items with a priority not greater are due.
+ * @param out Where the values are moved, in order of priority.
+ * @return The number of items deleted.
+ */
+template <class T, class Pos>
+template <class OutputIt>
+Pos TimingWheelPQ<T, Pos>::advanceTo(py_t time, OutputIt out) {
+  Pos count = 0;
+  while (size > 0) {
+    py_t due = pool.at(findMin())->priority;
+    if (due > time)
+      break; // the next item isn't due
+    advance(due);
+    unsigned s = lowest(occupied[0]); // the items at time (due)
+    Pos list = head[s];
+    head[s] = nil;
+    occupied[0] &= occupied[0] - 1;
+    while (list != nil) {
+      Pos i = list;
+      list = next[i];
+      *out++ = std::move(pool.at(i)->item);
+      release(i);
+      count++;
+    }
+  }
+  if (time > current)
+    advance(time);
+  return count;
+}
+
+/**
+ * Function for delete all the items in the queue. O(n).
+ *
+ * The current time is reset to zero, so any time can be emplaced again.
+ */
+template <class T, class Pos>
+void TimingWheelPQ<T, Pos>::clear() {
+  for (unsigned s=0; s < wheels * slots; s++) {
+    Pos list = head[s];
+    head[s] = nil;
+    while (list != nil) {
+      Pos i = list;
+      list = next[i];
+      release(i);
+    }
+  }
+  std::fill(occupied, occupied + wheels, 0);
+  current = 0;
+  first = nil;
+}
+
+#endif
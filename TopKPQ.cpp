@@ -0,0 +1,239 @@
+/**
+ * @file TopKPQ.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Bounded queue which keeps the K best items of a stream, on a BinHeapPQ
+ * with the worst kept item on the top.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef TOPKPQ_CPP
+#define TOPKPQ_CPP
+
+#include "BinHeapPQ.cpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Comparator in the reverse order of another one.
+ */
+template <class Compare>
+class ReverseCompare : private KeyCompare<Compare> {
+public:
+  ReverseCompare(const Compare& compare) : KeyCompare<Compare>(compare) {}
+  template <class Key>
+  bool operator()(const Key& a, const Key& b) const { return this->compare()(b, a); }
+};
+
+/**
+ * The reverse of a comparator: std::less and std::greater are swapped,
+ * so the heap keeps the branchless and vectorized selections (KeyTraits).
+ */
+template <class Compare>
+struct ReverseOrder {
+  typedef ReverseCompare<Compare> type;
+  static type make(const Compare& compare) { return type(compare); }
+};
+
+template <class Key>
+struct ReverseOrder<std::less<Key> > {
+  typedef std::greater<Key> type;
+  static type make(const std::less<Key>&) { return type(); }
+};
+
+template <class Key>
+struct ReverseOrder<std::greater<Key> > {
+  typedef std::less<Key> type;
+  static type make(const std::greater<Key>&) { return type(); }
+};
+
+/**
+ * Search of the first key better than a bound, in keys[i, n).
+ *
+ * This generic version is a scalar loop; the specialization for 32 bits
+ * unsigned keys compared by std::less or std::greater tests 8 keys
+ * (AVX2) or 4 keys (SSE4.1) at once, if enabled at compile time.
+ */
+template <class Key, class Compare, bool = std::is_same<Key, unsigned int>::value
+  && (std::is_same<Compare, std::less<unsigned int> >::value || std::is_same<Compare, std::greater<unsigned int> >::value)>
+struct KeyFilter {
+  static std::size_t next(const Key* keys, std::size_t i, std::size_t n, const Key& bound, const Compare& better) {
+    while (i < n && !better(keys[i], bound))
+      i++;
+    return i;
+  }
+};
+
+#ifdef BINHEAPPQ_SIMD
+template <class Compare>
+struct KeyFilter<unsigned int, Compare, true> {
+  static const bool least = std::is_same<Compare, std::less<unsigned int> >::value;
+  static std::size_t next(const unsigned int* keys, std::size_t i, std::size_t n, unsigned int bound, const Compare& better) {
+    // better than bound: not greater than bound-1 (least), or not lesser than bound+1
+    if (bound == (least ? 0u : ~0u))
+      return n; // nothing is better
+    unsigned int edge = least ? bound - 1 : bound + 1;
+#ifdef __AVX2__
+    const __m256i e8 = _mm256_set1_epi32(int(edge));
+    for (; i + 8 <= n; i += 8) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+      __m256i y = least ? _mm256_min_epu32(x, e8) : _mm256_max_epu32(x, e8);
+      unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, y)));
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+#endif
+#ifdef __SSE4_1__
+    const __m128i e4 = _mm_set1_epi32(int(edge));
+    for (; i + 4 <= n; i += 4) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+      __m128i y = least ? _mm_min_epu32(x, e4) : _mm_max_epu32(x, e4);
+      unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, y)));
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+#endif
+    return KeyFilter<unsigned int, Compare, false>::next(keys, i, n, bound, better);
+  }
+};
+#endif
+
+/**
+ * Queue of the K best items of a stream ("best" is the first for Compare,
+ * so with std::less the K lesser priorities).
+ *
+ * The items are kept in a BinHeapPQ ordered by the reverse comparator,
+ * with the worst of the kept items on the top: when the queue is full, a
+ * new item is compared with it and rejected in O(1), before its value is
+ * constructed and without any allocation; an item which qualifies takes
+ * the place of the worst one, with a single downRestore (replaceMin).
+ * offerBatch filters a whole array of priorities with vector compares
+ * (see KeyFilter) and touches the heap only for the items which qualify.
+ */
+template <class T, class Layout = InlineLayout, unsigned Arity = 4, class Pos = pos_t,
+          class Key = py_t, class Compare = std::less<Key>, class Stats = NoStats>
+class TopKPQ : private KeyCompare<Compare> {
+public:
+  typedef BinHeapPQ<T, Layout, Arity, Pos, Key, typename ReverseOrder<Compare>::type, Stats> Queue;
+  typedef Pos Size;				/**< Type of positions and sizes. */
+  typedef Key Priority;				/**< Type of the priorities.      */
+  typedef typename Queue::Handle Handle;	/**< Checked read-only pointer to an item. */
+private:
+  Queue queue;	/**< The kept items, the worst on the top. */
+  Pos k;	/**< Number of items kept.                 */
+  bool better(const Key& a, const Key& b) const { return this->compare()(a, b); }
+public:
+  TopKPQ(Pos, const Compare& = Compare());
+  bool isEmpty() { return queue.isEmpty(); }
+  bool isFull() { return queue.isFull(); }
+  const Key& worstPriority() { return queue.minPriority(); } // throw an exception if heap is empty
+  const T& worst() { return queue.top(); } // throw an exception if heap is empty
+  bool qualifies(const Key&);
+  template <class... Args>
+  Handle offer(const Key&, Args&&...);
+  std::size_t offerBatch(const Key*, const T*, std::size_t);
+  bool contains(Handle pi) { return queue.contains(pi); }
+  void deleteWorst() { queue.deleteMin(); }
+  void clear() { queue.clear(); }
+  template <class OutputIt>
+  Pos drain(OutputIt);
+  PQStats stats() const { return queue.stats(); }
+};
+
+/**
+ * Init the queue. O(k).
+ *
+ * @param k The number of items to keep.
+ * @param compare The comparator of the priorities, the best first.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+TopKPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::TopKPQ(Pos k, const Compare& compare)
+  : KeyCompare<Compare>(compare), queue(k, false, ReverseOrder<Compare>::make(compare)) {
+  this->k = k;
+}
+
+/**
+ * Check if an item with this priority would be kept. O(1).
+ *
+ * @param priority The priority of the item.
+ * @return True if the queue isn't full or the priority is better than the worst kept.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+bool TopKPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::qualifies(const Key& priority) {
+  if (!queue.isFull())
+    return true;
+  return k > 0 && better(priority, queue.minPriority());
+}
+
+/**
+ * Function for offering an item: it's kept if it's among the K best. O(1) or O(log(k)).
+ *
+ * The value is constructed only if the item is kept; in a full queue,
+ * the worst item is deleted to make place.
+ *
+ * @param priority The priority of the new item.
+ * @param args The arguments for the constructor of the value.
+ * @return A handle, for monitoring the item; null if it's rejected.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class... Args>
+typename TopKPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::Handle
+TopKPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::offer(const Key& priority, Args&&... args) {
+  if (!queue.isFull())
+    return queue.emplace(priority, std::forward<Args>(args)...);
+  if (k == 0 || !better(priority, queue.minPriority()))
+    return nullptr; // not better than the worst kept
+  return queue.replaceMin(priority, std::forward<Args>(args)...);
+}
+
+/**
+ * Function for offering an array of items. O(n + m*log(k)), m items kept.
+ *
+ * The priorities are compared with the worst kept one by KeyFilter, many
+ * at once; the bound is read again after every item kept (it can only
+ * get better, so the items already rejected stay rejected).
+ *
+ * @param priorities The priorities of the items.
+ * @param values The values of the items, copied if they are kept.
+ * @param n The number of items.
+ * @return The number of items kept (some of them can be already deleted by the next ones).
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+std::size_t TopKPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::offerBatch(const Key* priorities, const T* values, std::size_t n) {
+  std::size_t i = 0, kept = 0;
+  for (; i < n && !queue.isFull(); i++, kept++)
+    queue.emplace(priorities[i], values[i]);
+  if (i == n || queue.isEmpty())
+    return kept; // nothing left, or nothing kept (k is 0)
+  while ((i = KeyFilter<Key, Compare>::next(priorities, i, n, queue.minPriority(), this->compare())) < n) {
+    queue.replaceMin(priorities[i], values[i]);
+    i++;
+    kept++;
+  }
+  return kept;
+}
+
+/**
+ * Function for moving all the items out, from the best to the worst. O(k*log(k)).
+ *
+ * @param out Where the values are moved.
+ * @return The number of items.
+ */
+template <class T, class Layout, unsigned Arity, class Pos, class Key, class Compare, class Stats>
+template <class OutputIt>
+Pos TopKPQ<T, Layout, Arity, Pos, Key, Compare, Stats>::drain(OutputIt out) {
+  std::vector<T> values; // from the worst
+  while (!queue.isEmpty())
+    values.push_back(queue.popMin());
+  for (std::size_t i = values.size(); i-- > 0; )
+    *out++ = std::move(values[i]);
+  return Pos(values.size());
+}
+
+#endif
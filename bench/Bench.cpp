@@ -0,0 +1,95 @@
+/**
+ * @file Bench.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Common tools for the benchmarks: random generator, timer and (on Linux,
+ * if the kernel allows it) the hardware counter of cache misses.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#ifndef BENCH_CPP
+#define BENCH_CPP
+
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Small and fast pseudo-random generator (xorshift), so runs are reproducible.
+ */
+struct Rng {
+  unsigned long long s;
+  explicit Rng(unsigned long long seed) : s(seed) {}
+  unsigned int next() { s ^= s << 13; s ^= s >> 7; s ^= s << 17; return (unsigned int)(s >> 32); }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point start, unsigned long ops) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+}
+
+/**
+ * Counter of the last level cache misses of this thread.
+ *
+ * If the counter can't be opened (not Linux, no PMU in a VM, or
+ * perf_event_paranoid too high), available() is false and stop() returns -1.
+ */
+class CacheMisses {
+private:
+  int fd;
+public:
+  CacheMisses() : fd(-1) {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+  ~CacheMisses() {
+#ifdef __linux__
+    if (fd >= 0)
+      close(fd);
+#endif
+  }
+  CacheMisses(const CacheMisses&) = delete;
+  CacheMisses& operator=(const CacheMisses&) = delete;
+  bool available() const { return fd >= 0; }
+  void start() {
+#ifdef __linux__
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  long long stop() {
+    long long count = -1;
+#ifdef __linux__
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != sizeof(count))
+        count = -1;
+    }
+#endif
+    return count;
+  }
+};
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file BinHeapPQBench.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Benchmark of BinHeapPQ for different arities and layouts, and of the
+ * hole-based restore against the previous swap-based one.
+ * See BinHeapPQSuite.cpp for the complete suite. Build and run from the
+ * root of the repository with:
+ *   g++ -std=c++11 -O2 -DNDEBUG -I. bench/BinHeapPQBench.cpp -o bench_pq && ./bench_pq
+ * add -march=native (or -mavx2) to enable the vectorized child selection.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#include "BinHeapPQ.cpp"
+#include "Bench.cpp"
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * Emplace-heavy: three emplace for every deleteMin, until the queue is (almost) full.
+ */
+template <class Q>
+double emplaceHeavy(pos_t n) {
+  Q q(n);
+  Rng rng(1);
+  unsigned long ops = 0;
+  Clock::time_point start = Clock::now();
+  for (pos_t i=0; i + 3 <= n; i += 2) { // net +2 items every round
+    q.emplace(rng.next(), 0); q.emplace(rng.next(), 0); q.emplace(rng.next(), 0);
+    q.deleteMin();
+    ops += 4;
+  }
+  return nsPerOp(start, ops);
+}
+
+/**
+ * Pop-heavy: fill the queue (not timed), then drain it completely.
+ */
+template <class Q>
+double popHeavy(pos_t n) {
+  Q q(n);
+  Rng rng(2);
+  while (!q.isFull())
+    q.emplace(rng.next(), 0);
+  Clock::time_point start = Clock::now();
+  while (!q.isEmpty())
+    q.deleteMin();
+  return nsPerOp(start, n);
+}
+
+/**
+ * Decrease-heavy (Dijkstra-like): on a full queue, ten decrease for every
+ * deleteMin + emplace pair. The value stored is the index of its handle.
+ */
+template <class Q>
+double decreaseHeavy(pos_t n) {
+  Q q(n);
+  Rng rng(3);
+  typedef decltype(q.emplace(py_t(), pos_t())) Handle;
+  std::vector<Handle> handles(n);
+  for (pos_t i=0; i < n; i++)
+    handles[i] = q.emplace(rng.next() | 0x80000000u, i);
+  unsigned long ops = 0;
+  Clock::time_point start = Clock::now();
+  for (unsigned r=0; r < 4u*n; r++) {
+    for (int k=0; k < 10; k++) {
+      Handle h = handles[rng.next() % n];
+      q.decrease(h->priority - (h->priority >> 4) - 1, h);
+    }
+    pos_t i = q.min();
+    q.deleteMin();
+    handles[i] = q.emplace(rng.next() | 0x80000000u, i);
+    ops += 12;
+  }
+  return nsPerOp(start, ops);
+}
+
+/**
+ * Reference binary heap with the previous restore engine: pointers to the
+ * items and one swap (two pointers and two positions written) per level.
+ */
+template <class T>
+class SwapHeapPQ {
+private:
+  pos_t maxSize, size;
+  PriorityItem<T>** heap;
+  PriorityItem<T>* pool;
+  void swap(pos_t a, pos_t b) {
+    PriorityItem<T>* tmp = heap[a]; heap[a] = heap[b]; heap[b] = tmp;
+    heap[a]->pos = a; heap[b]->pos = b;
+  }
+  void upRestore(pos_t i) {
+    while (i > 0 && heap[i]->priority < heap[(i-1)/2]->priority) {
+      swap(i, (i-1)/2);
+      i = (i-1)/2;
+    }
+  }
+  void downRestore(pos_t i) {
+    for (;;) {
+      pos_t min = i;
+      if (2*i+1 < size && heap[2*i+1]->priority < heap[min]->priority) min = 2*i+1;
+      if (2*i+2 < size && heap[2*i+2]->priority < heap[min]->priority) min = 2*i+2;
+      if (min == i)
+        break;
+      swap(i, min);
+      i = min;
+    }
+  }
+public:
+  SwapHeapPQ(pos_t maxSize) : maxSize(maxSize), size(0) {
+    heap = new PriorityItem<T>*[maxSize];
+    pool = static_cast<PriorityItem<T>*>(::operator new(sizeof(PriorityItem<T>) * maxSize));
+    for (pos_t i=0; i < maxSize; i++)
+      heap[i] = pool + i;
+  }
+  ~SwapHeapPQ() {
+    for (pos_t i=0; i < size; i++)
+      heap[i]->~PriorityItem<T>();
+    ::operator delete(pool);
+    delete[] heap;
+  }
+  bool isEmpty() { return size == 0; }
+  bool isFull() { return size == maxSize; }
+  T min() { return heap[0]->item; }
+  const PriorityItem<T>* emplace(py_t priority, T item) {
+    if (size >= maxSize)
+      return nullptr;
+    PriorityItem<T>* pi = new (heap[size]) PriorityItem<T>(priority, size, item);
+    upRestore(size++);
+    return pi;
+  }
+  void decrease(py_t priority, const PriorityItem<T>* pi) {
+    if (priority >= pi->priority)
+      return;
+    heap[pi->pos]->priority = priority;
+    upRestore(pi->pos);
+  }
+  void deleteMin() {
+    swap(0, size-1);
+    heap[--size]->~PriorityItem<T>();
+    if (size > 1)
+      downRestore(0);
+  }
+};
+
+template <class Q>
+void row(const char* name, pos_t n) {
+  std::printf("%-22s %10.1f %10.1f %10.1f\n", name,
+    emplaceHeavy<Q>(n), popHeavy<Q>(n), decreaseHeavy<Q>(n));
+}
+
+int main() {
+  const pos_t n = 60000;
+  std::printf("n = %u, ns/op\n", (unsigned)n);
+  std::printf("%-22s %10s %10s %10s\n", "queue", "emplace", "pop", "decrease");
+  row<DAryHeapPQ<pos_t, 2> >("pointer, arity 2", n);
+  row<DAryHeapPQ<pos_t, 4> >("pointer, arity 4", n);
+  row<DAryHeapPQ<pos_t, 8> >("pointer, arity 8", n);
+  row<DAryHeapPQ<pos_t, 2, InlineLayout> >("inline, arity 2", n);
+  row<DAryHeapPQ<pos_t, 4, InlineLayout> >("inline, arity 4", n);
+  row<DAryHeapPQ<pos_t, 8, InlineLayout> >("inline, arity 8", n);
+  row<DAryHeapPQ<pos_t, 16, InlineLayout> >("inline, arity 16", n);
+  std::printf("\nrestore engine (pointer, arity 2)\n");
+  row<SwapHeapPQ<pos_t> >("swap (previous)", n);
+  row<BinHeapPQ<pos_t> >("hole", n);
+  return 0;
+}
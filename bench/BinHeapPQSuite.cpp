@@ -0,0 +1,279 @@
+/**
+ * @file BinHeapPQSuite.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Benchmark suite of the priority queues: every operation (emplace,
+ * deleteMin, decrease, increase, hold model and a mixed workload) for
+ * every queue size, priority distribution and payload size; it reports
+ * ns/op and, if available, the cache misses per operation.
+ * Build and run from the root of the repository with:
+ *   g++ -std=c++11 -O2 -DNDEBUG -I. bench/BinHeapPQSuite.cpp -o bench_suite && ./bench_suite
+ * Options (all optional) select a subset of the rows:
+ *   --queue=NAME --op=NAME --dist=NAME --payload=BYTES --min=N --max=N --mem=MB
+ * the sizes go from --min (default 1000) to --max (default 1000000) by
+ * powers of ten; --max=10000000 runs also the biggest size, and the rows
+ * that would need more than --mem megabytes (default 1024) of items are skipped.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#include "BinHeapPQ.cpp"
+#include "PairingHeapPQ.cpp"
+#include "RadixHeapPQ.cpp"
+#include "StableHeapPQ.cpp"
+#include "TimingWheelPQ.cpp"
+#include "Bench.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Value stored in the queue: the index of its handle, padded to N bytes.
+ */
+template <unsigned N>
+struct Payload {
+  uint32_t id;
+  char pad[N - sizeof(uint32_t)];
+  Payload(uint32_t id) : id(id) {}
+};
+
+template <>
+struct Payload<4> {
+  uint32_t id;
+  Payload(uint32_t id) : id(id) {}
+};
+
+/**
+ * Distribution of the priorities of the new items.
+ *
+ * Uniform is random; sorted and reverse are increasing and decreasing;
+ * hold is the classic "hold model": the new priority is the last one
+ * deleted plus a small random increment.
+ */
+enum Dist { UNIFORM, SORTED, REVERSE, HOLD };
+static const char* distNames[] = { "uniform", "sorted", "reverse", "hold" };
+
+struct Keys {
+  Dist dist;
+  Rng rng;
+  py_t counter;
+  Keys(Dist dist) : dist(dist), rng(42), counter(0) {}
+  py_t next(py_t last) {
+    switch (dist) {
+      case UNIFORM: return rng.next();
+      case SORTED:  return counter++;
+      case REVERSE: return ~py_t(0) - counter++;
+      default:      return last + rng.next() % 256;
+    }
+  }
+};
+
+/**
+ * If the queue needs monotone priorities (never lesser than the last
+ * minimum deleted): the hold and mixed workloads run only with the sorted
+ * and hold distributions.
+ */
+template <class Q>
+struct Monotone { static const bool value = false; };
+
+template <class T, class Pos>
+struct Monotone<RadixHeapPQ<T, Pos> > { static const bool value = true; };
+
+template <class T, class Pos>
+struct Monotone<TimingWheelPQ<T, Pos> > { static const bool value = true; };
+
+/**
+ * Options of the command line, used for select the rows.
+ */
+struct Options {
+  const char* queue;
+  const char* op;
+  const char* dist;
+  unsigned payload;
+  unsigned long min, max, mem;
+  Options() : queue(0), op(0), dist(0), payload(0), min(1000), max(1000000), mem(1024) {}
+  static bool match(const char* filter, const char* name) { return !filter || std::strcmp(filter, name) == 0; }
+};
+
+static Options options;
+
+/**
+ * Timer and cache misses counter of a single row.
+ */
+class Measure {
+private:
+  CacheMisses misses;
+  Clock::time_point startTime;
+public:
+  void start() { misses.start(); startTime = Clock::now(); }
+  void stop(const char* queue, unsigned payload, unsigned long n, Dist dist, const char* op, unsigned long ops) {
+    double ns = nsPerOp(startTime, ops);
+    long long count = misses.stop();
+    if (count >= 0)
+      std::printf("%-10s %8u %10lu %-8s %-10s %10.1f %12.3f\n", queue, payload, n, distNames[dist], op, ns, double(count) / ops);
+    else
+      std::printf("%-10s %8u %10lu %-8s %-10s %10.1f %12s\n", queue, payload, n, distNames[dist], op, ns, "n/a");
+    std::fflush(stdout);
+  }
+};
+
+/**
+ * All the operations on a queue of type Q, for a given size and distribution.
+ *
+ * Every workload starts from a new queue; a (not timed) fill with n items
+ * is done when the operation needs a full queue.
+ */
+template <class Q, unsigned N>
+struct Workloads {
+  typedef Payload<N> P;
+  typedef decltype(std::declval<Q&>().emplace(py_t(), P(0))) Handle;
+  
+  static void fill(Q& q, std::vector<Handle>& handles, Keys& keys, unsigned long n) {
+    handles.resize(n);
+    for (uint32_t i=0; i < n; i++)
+      handles[i] = q.emplace(keys.next(0), P(i));
+  }
+  
+  static void run(const char* name, unsigned long n, Dist dist) {
+    Measure m;
+    std::vector<Handle> handles;
+    Rng rng(7);
+    bool deletes = !Monotone<Q>::value || dist == SORTED || dist == HOLD; // emplace after deleteMin
+    
+    if (Options::match(options.op, "emplace")) {
+      Q q(n); Keys keys(dist);
+      handles.resize(n);
+      m.start();
+      for (uint32_t i=0; i < n; i++)
+        handles[i] = q.emplace(keys.next(i), P(i));
+      m.stop(name, N, n, dist, "emplace", n);
+    }
+    if (Options::match(options.op, "deleteMin")) {
+      Q q(n); Keys keys(dist);
+      fill(q, handles, keys, n);
+      m.start();
+      while (!q.isEmpty())
+        q.deleteMin();
+      m.stop(name, N, n, dist, "deleteMin", n);
+    }
+    if (Options::match(options.op, "decrease")) {
+      Q q(n); Keys keys(dist);
+      fill(q, handles, keys, n);
+      m.start();
+      for (unsigned long i=0; i < n; i++) {
+        Handle h = handles[rng.next() % n];
+        q.decrease(h->priority - (h->priority >> 3) - 1, h);
+      }
+      m.stop(name, N, n, dist, "decrease", n);
+    }
+    if (Options::match(options.op, "increase")) {
+      Q q(n); Keys keys(dist);
+      fill(q, handles, keys, n);
+      m.start();
+      for (unsigned long i=0; i < n; i++) {
+        Handle h = handles[rng.next() % n];
+        q.increase(h->priority + ((~py_t(0) - h->priority) >> 3) + 1, h);
+      }
+      m.stop(name, N, n, dist, "increase", n);
+    }
+    if (deletes && Options::match(options.op, "hold")) {
+      Q q(n); Keys keys(dist);
+      fill(q, handles, keys, n);
+      m.start();
+      for (unsigned long i=0; i < n; i++) {
+        uint32_t id = q.top().id;
+        py_t last = handles[id]->priority;
+        q.deleteMin();
+        handles[id] = q.emplace(keys.next(last), P(id));
+      }
+      m.stop(name, N, n, dist, "hold", 2*n);
+    }
+    if (deletes && Options::match(options.op, "mixed")) {
+      // half emplace, a quarter deleteMin, a quarter decrease, from half full
+      Q q(n); Keys keys(dist);
+      std::vector<uint32_t> free; // ids of the items deleted
+      fill(q, handles, keys, n/2);
+      handles.resize(n);
+      for (uint32_t i = n; i-- > n/2; )
+        free.push_back(i);
+      py_t last = 0;
+      m.start();
+      for (unsigned long i=0; i < n; i++) {
+        unsigned r = rng.next() % 4;
+        if ((r < 2 || q.isEmpty()) && !free.empty()) {
+          uint32_t id = free.back();
+          free.pop_back();
+          handles[id] = q.emplace(keys.next(last), P(id));
+        } else if (r == 2 && !q.isEmpty()) {
+          uint32_t id = q.top().id;
+          last = handles[id]->priority;
+          q.deleteMin();
+          handles[id] = Handle();
+          free.push_back(id);
+        } else {
+          Handle h = handles[rng.next() % n];
+          if (h)
+            q.decrease(h->priority - (h->priority >> 3), h);
+        }
+      }
+      m.stop(name, N, n, dist, "mixed", n);
+    }
+  }
+};
+
+template <class Q, unsigned N>
+void runQueue(const char* name) {
+  if (!Options::match(options.queue, name) || (options.payload && options.payload != N))
+    return;
+  for (unsigned long n = options.min; n <= options.max; n *= 10) {
+    if (n * (sizeof(PriorityItem<Payload<N>, uint32_t>) + 16) > options.mem << 20)
+      continue; // it would need too much memory
+    for (unsigned d = UNIFORM; d <= HOLD; d++)
+      if (Options::match(options.dist, distNames[d]))
+        Workloads<Q, N>::run(name, n, Dist(d));
+  }
+}
+
+/**
+ * The queues compared: add here a new engine or configuration.
+ */
+template <unsigned N>
+void runAll() {
+  runQueue<BinHeapPQ<Payload<N>, PointerLayout, 2, uint32_t>, N>("binary");
+  runQueue<DAryHeapPQ<Payload<N>, 4, InlineLayout, uint32_t>, N>("inline-4");
+  runQueue<DAryHeapPQ<Payload<N>, 4, BlockLayout<>, uint32_t>, N>("block-4");
+  runQueue<StableHeapPQ<Payload<N>, InlineLayout, 4, uint32_t>, N>("stable-4");
+  runQueue<PairingHeapPQ<Payload<N>, uint32_t>, N>("pairing");
+  runQueue<RadixHeapPQ<Payload<N>, uint32_t>, N>("radix");
+  runQueue<TimingWheelPQ<Payload<N>, uint32_t>, N>("wheel");
+}
+
+int main(int argc, char* argv[]) {
+  for (int i=1; i < argc; i++) {
+    const char* a = argv[i];
+    if (!std::strncmp(a, "--queue=", 8)) options.queue = a + 8;
+    else if (!std::strncmp(a, "--op=", 5)) options.op = a + 5;
+    else if (!std::strncmp(a, "--dist=", 7)) options.dist = a + 7;
+    else if (!std::strncmp(a, "--payload=", 10)) options.payload = std::strtoul(a + 10, 0, 10);
+    else if (!std::strncmp(a, "--min=", 6)) options.min = std::strtoul(a + 6, 0, 10);
+    else if (!std::strncmp(a, "--max=", 6)) options.max = std::strtoul(a + 6, 0, 10);
+    else if (!std::strncmp(a, "--mem=", 6)) options.mem = std::strtoul(a + 6, 0, 10);
+    else {
+      std::fprintf(stderr, "unknown option %s\n", a);
+      return 1;
+    }
+  }
+  if (options.min == 0)
+    options.min = 1;
+  std::printf("%-10s %8s %10s %-8s %-10s %10s %12s\n", "queue", "payload", "size", "dist", "op", "ns/op", "misses/op");
+  runAll<4>();
+  runAll<64>();
+  runAll<256>();
+  return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file MultiQueueBench.cpp
+ * @author MParolari	<https://github.com/MParolari>
+ *
+ * @section DESCRIPTION
+ * Throughput and rank error of MultiQueuePQ, for different numbers of
+ * threads and of sub-heaps per thread (c), against the strict ConcurrentPQ.
+ * Build and run from the root of the repository with:
+ *   g++ -std=c++11 -O2 -DNDEBUG -pthread -I. bench/MultiQueueBench.cpp -o bench_mq && ./bench_mq
+ * The rank error of a pop is the number of items, in the queue at that
+ * moment, with a priority lesser than the item deleted. It is measured
+ * in a second run, where every operation takes a ticket from a global
+ * counter; the log is then replayed in ticket order.
+ * https://github.com/MParolari/priority_queue
+ *
+ * @section LICENSE
+ * GNU GPLv2 - see LICENSE file
+ */
+
+#include "MultiQueuePQ.cpp"
+#include "Bench.cpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+typedef BinHeapPQ<uint64_t, InlineLayout, 4, uint32_t> Heap;
+
+static const unsigned prefill = 100000;	/**< Items in the queue before the run. */
+static const unsigned opsPerThread = 200000;	/**< Pairs (emplace, pop) per thread.   */
+
+/**
+ * An operation of the log: ticket, priority, and if it's a pop.
+ */
+struct LogEntry {
+  uint64_t ticket;
+  py_t priority;
+  bool pop;
+  bool operator<(const LogEntry& o) const { return ticket < o.ticket; }
+};
+
+/**
+ * Fenwick tree on the (compressed) priorities, for the rank of the pops.
+ */
+class Fenwick {
+private:
+  std::vector<long> tree;
+public:
+  Fenwick(std::size_t n) : tree(n + 1, 0) {}
+  void add(std::size_t i, long v) { for (i++; i < tree.size(); i += i & (~i + 1)) tree[i] += v; }
+  long prefix(std::size_t i) const { long s = 0; for (; i > 0; i -= i & (~i + 1)) s += tree[i]; return s; } // sum of [0, i)
+};
+
+/**
+ * Hold model: every thread alternates an emplace (priority = last deleted
+ * + random increment) and a pop. The value is the priority itself.
+ */
+template <class Q>
+void worker(Q& q, unsigned ops, std::atomic<uint64_t>* tickets, std::vector<LogEntry>* log) {
+  py_t last = 0;
+  for (unsigned i=0; i < ops; i++) {
+    py_t priority = last + threadRandom() % 1024;
+    if (log) {
+      LogEntry e = { tickets->fetch_add(1), priority, false };
+      q.emplace(priority, priority);
+      log->push_back(e);
+    } else
+      q.emplace(priority, priority);
+    uint64_t v;
+    if (log) {
+      uint64_t ticket = tickets->fetch_add(1);
+      if (q.tryPopMin(v)) {
+        LogEntry e = { ticket, py_t(v), true };
+        log->push_back(e);
+        last = py_t(v);
+      }
+    } else if (q.tryPopMin(v))
+      last = py_t(v);
+  }
+}
+
+template <class Q>
+void prefillQueue(Q& q, std::vector<LogEntry>* log) {
+  Rng rng(1);
+  for (unsigned i=0; i < prefill; i++) {
+    py_t priority = rng.next() % (1024 * 64);
+    q.emplace(priority, priority);
+    if (log) {
+      LogEntry e = { 0, priority, false };
+      log->push_back(e);
+    }
+  }
+}
+
+/**
+ * Throughput in millions of operations per second.
+ */
+template <class Q>
+double throughput(Q& q, unsigned threads) {
+  prefillQueue(q, 0);
+  std::vector<std::thread> pool;
+  Clock::time_point start = Clock::now();
+  for (unsigned t=0; t < threads; t++)
+    pool.push_back(std::thread(worker<Q>, std::ref(q), opsPerThread, (std::atomic<uint64_t>*)0, (std::vector<LogEntry>*)0));
+  for (unsigned t=0; t < threads; t++)
+    pool[t].join();
+  return 2.0 * opsPerThread * threads / (nsPerOp(start, 1) / 1e3);
+}
+
+/**
+ * Mean and max rank error of the pops.
+ */
+template <class Q>
+void rankError(Q& q, unsigned threads, double& mean, long& max) {
+  std::vector<std::vector<LogEntry> > logs(threads + 1);
+  prefillQueue(q, &logs[threads]);
+  std::atomic<uint64_t> tickets(1);
+  std::vector<std::thread> pool;
+  for (unsigned t=0; t < threads; t++) {
+    logs[t].reserve(2 * opsPerThread);
+    pool.push_back(std::thread(worker<Q>, std::ref(q), opsPerThread, &tickets, &logs[t]));
+  }
+  for (unsigned t=0; t < threads; t++)
+    pool[t].join();
+  
+  std::vector<LogEntry> all;
+  std::vector<py_t> keys;
+  for (unsigned t=0; t <= threads; t++)
+    all.insert(all.end(), logs[t].begin(), logs[t].end());
+  std::stable_sort(all.begin(), all.end()); // the prefill (ticket 0) first
+  for (std::size_t i=0; i < all.size(); i++)
+    keys.push_back(all[i].priority);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  
+  Fenwick present(keys.size());
+  double sum = 0;
+  unsigned long pops = 0;
+  max = 0;
+  for (std::size_t i=0; i < all.size(); i++) {
+    std::size_t k = std::lower_bound(keys.begin(), keys.end(), all[i].priority) - keys.begin();
+    if (all[i].pop) {
+      long rank = present.prefix(k);
+      sum += rank;
+      pops++;
+      if (rank > max)
+        max = rank;
+      present.add(k, -1);
+    } else
+      present.add(k, 1);
+  }
+  mean = pops ? sum / pops : 0;
+}
+
+template <class Q>
+void row(const char* name, unsigned threads, unsigned c, Q& forThroughput, Q& forRank) {
+  double mops = throughput(forThroughput, threads);
+  double mean;
+  long max;
+  rankError(forRank, threads, mean, max);
+  std::printf("%-8s %8u %4u %12.2f %12.1f %10ld\n", name, threads, c, mops, mean, max);
+  std::fflush(stdout);
+}
+
+int main() {
+  unsigned hw = std::thread::hardware_concurrency();
+  if (hw == 0)
+    hw = 4;
+  std::printf("%-8s %8s %4s %12s %12s %10s\n", "queue", "threads", "c", "Mops/s", "mean rank", "max rank");
+  for (unsigned threads = 1; threads <= 2 * hw && threads <= 64; threads *= 2) {
+    uint32_t capacity = prefill + 2 * opsPerThread * threads;
+    {
+      ConcurrentPQ<uint64_t, StrictOrder, Heap> a(capacity), b(capacity);
+      row("strict", threads, 0, a, b);
+    }
+    for (unsigned c = 1; c <= 8; c *= 2) {
+      uint32_t perHeap = capacity / (c * threads) * 2 + 1024;
+      MultiQueuePQ<uint64_t, Heap> a(perHeap, threads, c), b(perHeap, threads, c);
+      row("multi", threads, c, a, b);
+    }
+  }
+  return 0;
+}